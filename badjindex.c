@@ -1,17 +1,46 @@
 #include "graph.h"
 
-/* Create a badji file for a BADJ graph. */
+/* Create a badji file for a BADJ graph, which may be "-" for standard input. */
 int main(int argc, char *argv[])
 {
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
+    // Get badji file name
+    char *output = getoption(&argc, argv, "output");
+
     // Check arguments
     if (argc < 2)
     {
-        fprintf(stderr, "Usage: ./badjindex [BADJ file]\n");
+        fprintf(stderr, "Usage: ./badjindex [options] [BADJ file]\n");
+        return 1;
+    }
+    if (output == NULL && strcmp(argv[1], "-") == 0)
+    {
+        fprintf(stderr, "Graph on standard input needs --output=FILE.\n");
         return 1;
     }
+    if (strlen(argv[1]) > FILENAMELEN || (output != NULL && strlen(output) > FILENAMELEN))
+    {
+        fprintf(stderr, "Max file name length exceeded.\n");
+        return 1;
+    }
+    char badjiname[FILENAMELEN + 2];
+    if (output != NULL)
+    {
+        strcpy(badjiname, output);
+    }
+    else
+    {
+        strcpy(badjiname, argv[1]);
+        strcat(badjiname, "i");
+    }
     
     // Initialize graph
-    graph g;
     if (initialize(&g, argv[1], 0))
     {
         return 1;
@@ -22,10 +51,12 @@ int main(int argc, char *argv[])
     fprintf(stderr, "Edges: %llu\n\n", g.m);
 
     // Create badji file
-    badjindex(&g);
+    double start = omp_get_wtime();
+    int ret = badjindex(&g, badjiname);
+    fprintf(stderr, "Time: %.3f s\n", omp_get_wtime() - start);
 
     // Destroy graph
     destroy(&g);
 
-    return 0;
+    return ret;
 }
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Benchmarks stream, pagerank, and components on a generated graph across
+# thread counts and block lengths, and prints one CSV row per run.
+#
+# Settings come from environment variables:
+#   MODEL (rmat), SCALE (20), EDGEFACTOR (16): graph passed to ./gen
+#   GRAPH: existing BADJ graph to use instead of a generated one
+#   THREADS ("1 <number of CPUs>"), BLOCKLENS ("1048576 16777216"): runs
+#   ITERS (10): PageRank iterations
+set -e
+
+MODEL=${MODEL:-rmat}
+SCALE=${SCALE:-20}
+EDGEFACTOR=${EDGEFACTOR:-16}
+GRAPH=${GRAPH:-bench-$MODEL-$SCALE-$EDGEFACTOR.badj}
+THREADS=${THREADS:-"1 $(nproc)"}
+BLOCKLENS=${BLOCKLENS:-"1048576 16777216"}
+ITERS=${ITERS:-10}
+
+# Generate graph unless it exists
+if [ ! -f "$GRAPH" ]; then
+    ./gen "$MODEL" "$SCALE" "$EDGEFACTOR" "$GRAPH" 2>/dev/null
+fi
+
+# Get numbers of nodes and edges and length of graph file
+set -- $(od -An -t u8 -N 16 "$GRAPH")
+NODES=$1
+EDGES=$2
+BYTES=$(wc -c < "$GRAPH")
+
+# Sum the times printed by a tool for each pass over the graph and print a CSV row
+report() {
+    awk -v run="$1" -v nodes="$NODES" -v edges="$EDGES" -v bytes="$BYTES" '
+        /^Time: / || /^Components: .* s\)$/ || /^[0-9]+: .* s\)$/ {
+            t = $(NF-1)
+            gsub(/\(/, "", t)
+            total += t
+            passes++
+        }
+        END {
+            # Leave rates blank if runs are too short to time
+            if (total == 0) {
+                printf "%s,%s,%s,%s,%d,0,0,,\n", run, nodes, edges, bytes, passes
+                exit
+            }
+            printf "%s,%s,%s,%s,%d,%.6f,%.6f,%.0f,%.3f\n", run, nodes, edges, bytes, passes, total, total / passes,
+                edges * passes / total, bytes * passes / total / 1e9
+        }'
+}
+
+echo "tool,threads,blocklen,nodes,edges,bytes,passes,seconds,seconds_per_pass,edges_per_s,gb_per_s"
+for b in $BLOCKLENS; do
+    ./badjindex --blocklen="$b" "$GRAPH" 2>/dev/null
+    for t in $THREADS; do
+        ./stream --threads="$t" "$GRAPH" 2>&1 >/dev/null | report "stream,$t,$b"
+        ./pagerank --threads="$t" "$GRAPH" "$ITERS" 2>&1 >/dev/null | report "pagerank,$t,$b"
+        ./pagerank --threads="$t" --mode=blocked "$GRAPH" "$ITERS" 2>&1 >/dev/null | report "pagerank-blocked,$t,$b"
+        ./components --threads="$t" "$GRAPH" 1000 2>&1 >/dev/null | report "components,$t,$b"
+        ./components --threads="$t" --engine=unionfind "$GRAPH" 1000 2>&1 >/dev/null | report "unionfind,$t,$b"
+    done
+done
@@ -1,105 +1,85 @@
-#define _GNU_SOURCE
-#include <fcntl.h>
-#include <sys/mman.h>
 #include "graph.h"
 
-/* Perform Label Propagation. */
-int propagate(graph *g, int maxit, unsigned int *x)
+/* Kernels over 32-bit labels */
+#define LABEL unsigned int
+#define ADJ adj
+#define NAME(f) f##32
+#include "labels.h"
+#undef LABEL
+#undef ADJ
+#undef NAME
+
+/* Kernels over 64-bit labels */
+#define LABEL unsigned long long
+#define ADJ adj64
+#define NAME(f) f##64
+#include "labels.h"
+#undef LABEL
+#undef ADJ
+#undef NAME
+
+/* Computes the connected components of a graph in BADJ 
+ * format using Label Propagation or Union-Find. */
+int main(int argc, char *argv[])
 {
-    // Initialize x to node numbers
-    unsigned int i;
-    for (i = 0; i < g->n; i++)
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
     {
-        x[i] = i;
+        return 1;
     }
 
-    // Get next blocks
-    for (i = 0; i < NTHREADS; i++)
+    // Get permutation file of a reordered graph
+    char *permname = getoption(&argc, argv, "perm");
+
+    // Get whether to skip unchanged blocks in Label Propagation
+    char frontier = (getoption(&argc, argv, "frontier") != NULL);
+
+    // Get engine
+    char uf = 0;
+    char *engine = getoption(&argc, argv, "engine");
+    if (engine != NULL && strcmp(engine, "unionfind") == 0)
     {
-        nextblock(g, i);
+        uf = 1;
     }
-
-    // For each iteration
-    unsigned int iter = 0;
-    while (iter < maxit)
+    else if (engine != NULL && strcmp(engine, "propagate") != 0)
     {
-        // Propagate labels
-        unsigned int nprops = 0;
-        #pragma omp parallel
-        {
-            unsigned int threadno = omp_get_thread_num();
-            while (1)
-            {
-                while (1)
-                {
-                    // Get the next node
-                    node v;
-                    unsigned int i = nextnode(g, &v, threadno);
-                    if (i == (unsigned int) -1)
-                    {
-                        break;
-                    }
-
-                    // Compute update for neighbors
-                    unsigned int j;
-                    for (j = 0; j < v.deg; j++)
-                    {
-                        unsigned int vadjj = v.adj[j];
-                        
-                        if (x[i] < x[vadjj])
-                        {
-                            x[vadjj] = x[i];
-                            nprops++;
-                        }
-                        else if (x[i] > x[vadjj])
-                        {
-                            x[i] = x[vadjj];
-                            nprops++;
-                        }
-                    }
-                    free(v.adj);
-                }
-
-                // Get the next block
-                nextblock(g, threadno);
-
-                // Check if iteration is over
-                if (g->currblockno[threadno] <= NTHREADS)
-                {
-                    break;
-                }
-            }
-        }
-
-        // Update number of iterations
-        iter++;
-        
-        // Print number of propagations
-        fprintf(stderr, "%d: %d\n", iter, nprops);
-        
-        // Stop iterating if no propagations
-        if (nprops == 0)
-        {
-            break;
-        }
+        fprintf(stderr, "Unknown engine: %s\n", engine);
+        return 1;
     }
 
-    return 0;
-}
+    // Get checkpoint file, checkpoint interval, and whether to resume
+    checkpoint ck = {getoption(&argc, argv, "checkpoint"), "labels", 10, 0, 0};
+    char *value = getoption(&argc, argv, "interval");
+    if (value != NULL)
+    {
+        ck.interval = atoi(value);
+    }
+    char resume = (getoption(&argc, argv, "resume") != NULL);
+    if (ck.interval < 1)
+    {
+        fprintf(stderr, "Checkpoint interval must be positive.\n");
+        return 1;
+    }
+    if (resume && ck.filename == NULL)
+    {
+        fprintf(stderr, "Resuming requires a checkpoint file.\n");
+        return 1;
+    }
+    if (ck.filename != NULL && uf)
+    {
+        fprintf(stderr, "Checkpoints are not supported by union-find.\n");
+        return 1;
+    }
 
-/* Computes the connected components of a graph in BADJ 
- * format using Label Propagation. */
-int main(int argc, char *argv[])
-{
     // Check arguments
     if (argc < 3)
     {
-        fprintf(stderr, "Usage: ./components [BADJ file] [maxiter] [optional out file]\n");
+        fprintf(stderr, "Usage: ./components [options] [BADJ file] [maxiter] [optional out file]\n");
         return 1;
     }
     
     // Initialize graph
-    graph g;
     if (initialize(&g, argv[1], 1))
     {
         return 1;
@@ -109,6 +89,13 @@ int main(int argc, char *argv[])
     fprintf(stderr, "Nodes: %llu\n", g.n);
     fprintf(stderr, "Edges: %llu\n\n", g.m);
 
+    // Read permutation
+    unsigned long long *perm = NULL;
+    if (permname != NULL && (perm = readperm(&g, permname)) == NULL)
+    {
+        return 1;
+    }
+
     // Set number of iterations
     int maxit = atoi(argv[2]);
 
@@ -119,57 +106,63 @@ int main(int argc, char *argv[])
         ooc = 1;
     }
 
-    // Initialize label vector
-    FILE *xfile;
-    unsigned int *x;
-    if (!ooc)
+    // Initialize label vector, whose labels are as wide as node numbers,
+    // placed across sockets by the node ranges threads own, with the
+    // temporary file of an out-of-core vector next to the output
+    char *near = (argc > 3) ? argv[3] : argv[1];
+    void *x = allocvector(g.n * g.idlen, ooc, near);
+    if (x == NULL)
     {
-        x = malloc(g.n * sizeof(unsigned int));
-    }
-    else
-    {
-        xfile = fopen("xfile.tmp", "w+");
-        fallocate(fileno(xfile), 0, 0, g.n * sizeof(unsigned int));
-        x = (unsigned int *) mmap(NULL, g.n * sizeof(unsigned int), PROT_READ|PROT_WRITE, MAP_SHARED, fileno(xfile), 0);
+        fprintf(stderr, "Could not allocate labels.\n");
+        return 1;
     }
+    placevector(&g, x, g.idlen);
     
-    // Perform Label Propagation
-    propagate(&g, maxit, x);
-
-    // Optionally output x and destroy label vector
-    if (!ooc)
+    // Resume from checkpoint if there is one
+    if (resume && access(ck.filename, F_OK) == 0)
     {
-        if (argc > 3)
+        if (readcheckpoint(&ck, &g, x, g.idlen, g.n))
         {
-            FILE *out = fopen(argv[3], "w");
-            if (out == NULL)
-            {
-                fprintf(stderr, "Could not open output file.\n");
-            }
-            else
-            {
-                fwrite(x, sizeof(unsigned int), g.n, out);
-                fclose(out);
-            }
+            return 1;
         }
-        free(x);
+        fprintf(stderr, "Resuming from iteration %u\n", ck.iter);
+    }
+
+    // Perform Label Propagation or Union-Find
+    if (!uf && !g.wide)
+    {
+        propagate32(&g, maxit, frontier, x, &ck);
+    }
+    else if (!uf)
+    {
+        propagate64(&g, maxit, frontier, x, &ck);
+    }
+    else if (!g.wide)
+    {
+        unionfind32(&g, x);
     }
     else
     {
-        if (argc > 3)
-        {
-            rename("xfile.tmp", argv[3]);
-            fclose(xfile);
-        }
-        else
-        {
-            fclose(xfile);
-            remove("xfile.tmp");
-        }
+        unionfind64(&g, x);
     }
-   
-    // Destroy graph
+
+    // Optionally output x in original node order
+    int ret = 0;
+    if (argc > 3 && !g.wide)
+    {
+        ret = output32(argv[3], x, g.n, perm);
+    }
+    else if (argc > 3)
+    {
+        ret = output64(argv[3], x, g.n, perm);
+    }
+
+    // Destroy label vector
+    freevector(x, g.n * g.idlen, ooc);
+
+    // Destroy permutation and graph
+    free(perm);
     destroy(&g);
 
-    return 0;
+    return ret;
 }
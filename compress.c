@@ -0,0 +1,41 @@
+#include "graph.h"
+
+/* Compresses a BADJ graph into CBADJ format. */
+int main(int argc, char *argv[])
+{
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
+    // Check arguments
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: ./compress [options] [BADJ file] [CBADJ file]\n");
+        return 1;
+    }
+    
+    // Initialize graph
+    if (initialize(&g, argv[1], 0))
+    {
+        return 1;
+    }
+
+    // Print numbers of nodes and edges
+    fprintf(stderr, "Nodes: %llu\n", g.n);
+    fprintf(stderr, "Edges: %llu\n\n", g.m);
+
+    // Compress graph
+    if (compress(&g, argv[2]))
+    {
+        destroy(&g);
+        return 1;
+    }
+
+    // Destroy graph
+    destroy(&g);
+
+    return 0;
+}
@@ -0,0 +1,374 @@
+#include "graph.h"
+
+#define CHUNKLEN 65536
+
+/* Initiator probabilities of R-MAT and Kronecker graphs, as in Graph500 */
+#define RMATA 0.57
+#define RMATB 0.19
+#define RMATC 0.19
+
+/* Advance a splitmix64 random number generator. */
+static unsigned long long nextrandom(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Get a random number uniform in [0, 1). */
+static double uniform(unsigned long long *state)
+{
+    return (nextrandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Compare node numbers. */
+static int comparenodes(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *) a;
+    unsigned int y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+/* Compare 64-bit node numbers. */
+static int comparenodes64(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *) a;
+    unsigned long long y = *(const unsigned long long *) b;
+    return (x > y) - (x < y);
+}
+
+/* Print the progress of a phase of generation every g->progress seconds. */
+static void reportprogress(graph *g, char *phase, unsigned long long done, unsigned long long total)
+{
+    double now = omp_get_wtime();
+    double lastprogress;
+    #pragma omp atomic read
+    lastprogress = g->lastprogress;
+    if (g->progress > 0.0 && now - lastprogress >= g->progress)
+    {
+        #pragma omp critical(progress)
+        if (now - g->lastprogress >= g->progress)
+        {
+            #pragma omp atomic write
+            g->lastprogress = now;
+            fprintf(stderr, "Progress: %s %llu of %llu (%.3f s)\n", phase, done, total, now - g->initialized);
+        }
+    }
+}
+
+/* Generate the edges of a random graph with 2^scale nodes into arrays of
+ * node numbers of idlen bytes. Edges are drawn in fixed chunks, each with
+ * its own random number generator, so the graph depends on the seed but
+ * not on the number of threads. */
+int generate(graph *g, char *model, unsigned int scale, unsigned long long m, unsigned long long seed, void *src, void *dst)
+{
+    unsigned int idlen = g->idlen;
+    unsigned long long n = 1ULL << scale;
+    char rmat = (strcmp(model, "er") != 0);
+
+    // Draw edges
+    unsigned long long nchunks = (m + CHUNKLEN - 1) / CHUNKLEN;
+    long long k;
+    #pragma omp parallel for schedule(dynamic)
+    for (k = 0; k < (long long) nchunks; k++)
+    {
+        unsigned long long state = seed * 0xd1b54a32d192ed03ULL + k;
+        nextrandom(&state);
+        unsigned long long e;
+        unsigned long long end = (k + 1) * CHUNKLEN < m ? (k + 1) * CHUNKLEN : m;
+        for (e = k * CHUNKLEN; e < end; e++)
+        {
+            if (rmat)
+            {
+                // Choose a quadrant of the adjacency matrix at each level
+                unsigned long long u = 0;
+                unsigned long long v = 0;
+                unsigned int level;
+                for (level = 0; level < scale; level++)
+                {
+                    double r = uniform(&state);
+                    u <<= 1;
+                    v <<= 1;
+                    if (r >= RMATA + RMATB + RMATC)
+                    {
+                        u |= 1;
+                        v |= 1;
+                    }
+                    else if (r >= RMATA + RMATB)
+                    {
+                        u |= 1;
+                    }
+                    else if (r >= RMATA)
+                    {
+                        v |= 1;
+                    }
+                }
+                setid(src, e, u, idlen);
+                setid(dst, e, v, idlen);
+            }
+            else
+            {
+                // Choose both endpoints uniformly
+                setid(src, e, nextrandom(&state) & (n - 1), idlen);
+                setid(dst, e, nextrandom(&state) & (n - 1), idlen);
+            }
+        }
+        reportprogress(g, "generating chunk", k + 1, nchunks);
+    }
+
+    // Scatter hubs of Kronecker graphs with a random permutation of the nodes
+    if (strcmp(model, "kron") == 0)
+    {
+        void *perm = malloc(n * idlen);
+        if (perm == NULL)
+        {
+            fprintf(stderr, "Could not allocate permutation.\n");
+            return 1;
+        }
+        unsigned long long state = seed;
+        unsigned long long i;
+        for (i = 0; i < n; i++)
+        {
+            setid(perm, i, i, idlen);
+        }
+        for (i = n - 1; i > 0; i--)
+        {
+            unsigned long long j = nextrandom(&state) % (i + 1);
+            unsigned long long tmp = getid(perm, i, idlen);
+            setid(perm, i, getid(perm, j, idlen), idlen);
+            setid(perm, j, tmp, idlen);
+        }
+        long long e;
+        #pragma omp parallel for
+        for (e = 0; e < (long long) m; e++)
+        {
+            setid(src, e, getid(perm, getid(src, e, idlen), idlen), idlen);
+            setid(dst, e, getid(perm, getid(dst, e, idlen), idlen), idlen);
+        }
+        free(perm);
+    }
+
+    return 0;
+}
+
+/* Write edges as a BADJ or BADJ64 graph, with node numbers of the graph's
+ * width, along with its badji file. */
+int writegraph(graph *g, unsigned long long n, unsigned long long m, void *src, void *dst, char *filename)
+{
+    // Count out-degrees
+    unsigned int idlen = g->idlen;
+    unsigned long long *start = calloc(n + 1, sizeof(unsigned long long));
+    void *adj = malloc(m * idlen);
+    if (start == NULL || adj == NULL)
+    {
+        fprintf(stderr, "Could not allocate graph.\n");
+        free(start);
+        free(adj);
+        return 1;
+    }
+    long long e;
+    #pragma omp parallel for
+    for (e = 0; e < (long long) m; e++)
+    {
+        #pragma omp atomic
+        start[getid(src, e, idlen) + 1]++;
+    }
+
+    // Prefix sum out-degrees
+    unsigned long long i;
+    for (i = 0; i < n; i++)
+    {
+        start[i+1] += start[i];
+    }
+
+    // Scatter edges into adjacency lists
+    unsigned long long *curr = malloc(n * sizeof(unsigned long long));
+    if (curr == NULL)
+    {
+        fprintf(stderr, "Could not allocate graph.\n");
+        free(start);
+        free(adj);
+        return 1;
+    }
+    memcpy(curr, start, n * sizeof(unsigned long long));
+    #pragma omp parallel for
+    for (e = 0; e < (long long) m; e++)
+    {
+        unsigned long long pos;
+        #pragma omp atomic capture
+        pos = curr[getid(src, e, idlen)]++;
+        setid(adj, pos, getid(dst, e, idlen), idlen);
+    }
+    free(curr);
+
+    // Sort adjacency lists so output does not depend on thread timing
+    long long v;
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (v = 0; v < (long long) n; v++)
+    {
+        qsort((char *) adj + start[v] * idlen, start[v+1] - start[v], idlen, g->wide ? comparenodes64 : comparenodes);
+    }
+
+    // Create BADJ file
+    FILE *out = fopen(filename, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open file.\n");
+        free(start);
+        free(adj);
+        return 1;
+    }
+
+    // Write numbers of nodes and edges
+    char failed = 0;
+    failed |= (fwrite(&n, sizeof(unsigned long long), 1, out) != 1);
+    failed |= (fwrite(&m, sizeof(unsigned long long), 1, out) != 1);
+
+    // Write nodes and index them
+    indexer ix;
+    initindex(&ix, g);
+    for (i = 0; i < n; i++)
+    {
+        unsigned long long deg = start[i+1] - start[i];
+        unsigned long long degid;
+        setid(&degid, 0, deg, idlen);
+        failed |= (fwrite(&degid, idlen, 1, out) != 1);
+        failed |= (fwrite((char *) adj + start[i] * idlen, idlen, deg, out) != deg);
+        indexnode(&ix, (1 + deg) * idlen, deg);
+        indexdata(&ix, &degid, idlen);
+        indexdata(&ix, (char *) adj + start[i] * idlen, deg * idlen);
+        if ((i & (CHUNKLEN - 1)) == 0)
+        {
+            reportprogress(g, "writing node", i + 1, n);
+        }
+    }
+    failed |= (fclose(out) != 0);
+    free(start);
+    free(adj);
+    if (failed)
+    {
+        fprintf(stderr, "Could not write graph.\n");
+        remove(filename);
+        free(ix.indices);
+        free(ix.firstnodes);
+        free(ix.edges);
+        free(ix.bytes);
+        free(ix.checksums);
+        return 1;
+    }
+
+    // Write badji file
+    char badjiname[FILENAMELEN + 2];
+    strcpy(badjiname, filename);
+    strcat(badjiname, "i");
+    return writeindex(&ix, badjiname);
+}
+
+/* Generates a random graph in BADJ format. */
+int main(int argc, char *argv[])
+{
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+    omp_set_num_threads(g.nthreads);
+
+    // Get seed
+    unsigned long long seed = 1;
+    char *value = getoption(&argc, argv, "seed");
+    if (value != NULL)
+    {
+        seed = strtoull(value, NULL, 10);
+    }
+
+    // Check arguments
+    if (argc < 5)
+    {
+        fprintf(stderr, "Usage: ./gen [options] [rmat|kron|er] [scale] [edge factor] [BADJ file]\n");
+        return 1;
+    }
+    char *model = argv[1];
+    if (strcmp(model, "rmat") != 0 && strcmp(model, "kron") != 0 && strcmp(model, "er") != 0)
+    {
+        fprintf(stderr, "Unknown model: %s\n", model);
+        return 1;
+    }
+    if (strlen(argv[4]) > FILENAMELEN)
+    {
+        fprintf(stderr, "Max file name length exceeded.\n");
+        return 1;
+    }
+
+    // Check for unweighted format
+    if (weightlen(argv[4]) != 0)
+    {
+        fprintf(stderr, "Generated graphs are unweighted. Add weights with ./weight.\n");
+        return 1;
+    }
+
+    // Write 64-bit node numbers if the file name asks for them
+    g.wide = iswide(argv[4]);
+    g.idlen = g.wide ? sizeof(unsigned long long) : sizeof(unsigned int);
+    if (checkoutput(&g, argv[4], 0))
+    {
+        return 1;
+    }
+    unsigned int maxscale = g.wide ? 40 : 32;
+    unsigned int scale = atoi(argv[2]);
+    if (scale < 1 || scale > maxscale)
+    {
+        fprintf(stderr, "Scale must be between 1 and %u for this format.\n", maxscale);
+        return 1;
+    }
+    unsigned long long n = 1ULL << scale;
+    unsigned long long m = n * strtoull(argv[3], NULL, 10);
+
+    // Print numbers of nodes and edges
+    fprintf(stderr, "Nodes: %llu\n", n);
+    fprintf(stderr, "Edges: %llu\n\n", m);
+
+    // Generate edges
+    g.initialized = omp_get_wtime();
+    g.lastprogress = g.initialized;
+    void *src = malloc(m * g.idlen);
+    void *dst = malloc(m * g.idlen);
+    if (src == NULL || dst == NULL)
+    {
+        fprintf(stderr, "Could not allocate edges.\n");
+        free(src);
+        free(dst);
+        return 1;
+    }
+    int ret = generate(&g, model, scale, m, seed, src, dst);
+
+    // Write graph
+    if (!ret)
+    {
+        ret = writegraph(&g, n, m, src, dst, argv[4]);
+    }
+    if (!ret)
+    {
+        double time = omp_get_wtime() - g.initialized;
+        fprintf(stderr, "Time: %.3f s\n", time);
+
+        // Print metrics, counting the bytes of the graph file written
+        if (g.metrics)
+        {
+            fprintf(stderr, "{\"tool\": ");
+            printstring(stderr, g.tool);
+            fprintf(stderr, ", \"file\": ");
+            printstring(stderr, argv[4]);
+            fprintf(stderr, ", \"threads\": %u, \"nodes\": %llu, \"edges\": %llu, \"time\": %.6f, \"bytes\": %llu}\n",
+                    g.nthreads, n, m, time, 2 * sizeof(unsigned long long) + (n + m) * g.idlen);
+        }
+    }
+
+    // Clean up
+    free(src);
+    free(dst);
+
+    return ret;
+}
@@ -1,10 +1,303 @@
+#define _GNU_SOURCE
 #include "graph.h"
 
+static void accountidle(graph *g);
+static void sumcounters(graph *g, pass *p);
+static unsigned long long blockend(graph *g, unsigned long long blockno);
+static unsigned long long blockfirst(graph *g, unsigned long long blockno);
+static void prefetchblock(graph *g, unsigned long long blockno);
+static char *allocblockbuf(graph *g);
+static unsigned long long claimblock(graph *g, unsigned int threadno);
+
+/* Decode a variable-length integer stored 7 bits per byte, low bits first. */
+static inline unsigned long long getvarint(unsigned char **p)
+{
+    unsigned long long x = 0;
+    unsigned int shift = 0;
+    while (**p & 0x80)
+    {
+        x |= (unsigned long long) (**p & 0x7f) << shift;
+        shift += 7;
+        (*p)++;
+    }
+    x |= (unsigned long long) **p << shift;
+    (*p)++;
+    return x;
+}
+
+/* Encode a variable-length integer stored 7 bits per byte, low bits first. */
+static inline unsigned int putvarint(unsigned char *p, unsigned long long x)
+{
+    unsigned int len = 0;
+    while (x >= 0x80)
+    {
+        p[len++] = (x & 0x7f) | 0x80;
+        x >>= 7;
+    }
+    p[len++] = x;
+    return len;
+}
+
+/* Continue a 64-bit FNV-1a checksum over len bytes. */
+static unsigned long long checksum(unsigned long long h, unsigned char *data, unsigned long long len)
+{
+    unsigned long long i;
+    for (i = 0; i < len; i++)
+    {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* Read count node numbers of idlen bytes each into an array of 8-byte
+ * node numbers, returning how many were read. */
+static unsigned long long readids(FILE *in, unsigned long long *ids, unsigned long long count, unsigned int idlen)
+{
+    unsigned long long nread = fread(ids, idlen, count, in);
+
+    // Widen 4-byte node numbers in place, from the end
+    unsigned long long i;
+    for (i = nread; idlen == 4 && i > 0; i--)
+    {
+        ids[i-1] = ((unsigned int *) ids)[i-1];
+    }
+    return nread;
+}
+
+/* Write count 8-byte node numbers as node numbers of idlen bytes each. */
+static void writeids(FILE *out, unsigned long long *ids, unsigned long long count, unsigned int idlen)
+{
+    if (idlen == 8)
+    {
+        fwrite(ids, idlen, count, out);
+        return;
+    }
+
+    // Narrow node numbers through a buffer
+    unsigned int buf[1024];
+    unsigned long long i;
+    for (i = 0; i < count; i += 1024)
+    {
+        unsigned long long len = (count - i < 1024) ? count - i : 1024;
+        unsigned long long j;
+        for (j = 0; j < len; j++)
+        {
+            buf[j] = ids[i+j];
+        }
+        fwrite(buf, idlen, len, out);
+    }
+}
+
+/* Read the degree and adjacency list of the next node of a graph read
+ * sequentially into a buffer of node numbers of the graph's width,
+ * followed by the weights of its edges if the graph is weighted,
+ * growing the buffer of buflen bytes as needed, and return the degree. */
+static unsigned long long readnode(graph *g, void **buf, unsigned long long *buflen)
+{
+    unsigned long long deg = 0;
+    if (fread(&deg, g->idlen, 1, g->stream) == 1)
+    {
+        deg = getid(&deg, 0, g->idlen);
+    }
+    unsigned long long len = deg * g->idlen + weightbytes(deg, g->wlen, g->idlen);
+    if (len > *buflen)
+    {
+        *buflen = len;
+        free(*buf);
+        *buf = malloc(len);
+    }
+    fread(*buf, 1, len, g->stream);
+    return deg;
+}
+
+/* Get and remove a command-line option of the form --name=value or --name. */
+char *getoption(int *argc, char *argv[], char *name)
+{
+    size_t len = strlen(name);
+
+    // For each argument
+    int i;
+    for (i = 1; i < *argc; i++)
+    {
+        // Test whether argument is the option
+        char *arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, len) != 0 || (arg[2+len] != '=' && arg[2+len] != '\0'))
+        {
+            continue;
+        }
+
+        // Remove option from arguments
+        int j;
+        for (j = i; j < *argc - 1; j++)
+        {
+            argv[j] = argv[j+1];
+        }
+        (*argc)--;
+        argv[*argc] = NULL;
+
+        // Return value, or empty string if there is none
+        return (arg[2+len] == '=') ? arg + 3 + len : arg + 2 + len;
+    }
+
+    return NULL;
+}
+
+/* Get a setting from a command-line option or, failing that, an environment variable. */
+static char *getsetting(int *argc, char *argv[], char *name, char *env)
+{
+    char *value = getoption(argc, argv, name);
+    if (value == NULL)
+    {
+        value = getenv(env);
+    }
+    return value;
+}
+
+/* Configure graph from environment variables and command-line options. */
+int configure(graph *g, int *argc, char *argv[])
+{
+    // Set defaults
+    g->nthreads = omp_get_max_threads();
+    g->blocklen = BLOCKLEN;
+    g->maxblks = MAXBLKS;
+    g->usemap = 1;
+    g->align = 0;
+    g->prefetch = 0;
+    g->affinity = 0;
+    g->tool = argv[0];
+    g->metrics = 0;
+    g->progress = 0.0;
+
+    // Override defaults
+    char *value;
+    if ((value = getsetting(argc, argv, "threads", "BADJ_THREADS")) != NULL)
+    {
+        g->nthreads = atoi(value);
+    }
+    if ((value = getsetting(argc, argv, "blocklen", "BADJ_BLOCKLEN")) != NULL)
+    {
+        g->blocklen = strtoull(value, NULL, 10);
+    }
+    if ((value = getsetting(argc, argv, "maxblks", "BADJ_MAXBLKS")) != NULL)
+    {
+        g->maxblks = strtoull(value, NULL, 10);
+    }
+    if ((value = getsetting(argc, argv, "mmap", "BADJ_MMAP")) != NULL)
+    {
+        g->usemap = (atoi(value) != 0);
+    }
+    if ((value = getsetting(argc, argv, "direct", "BADJ_DIRECT")) != NULL)
+    {
+        g->align = (*value == '\0') ? DIRECTALIGN : strtoull(value, NULL, 10);
+    }
+    if ((value = getsetting(argc, argv, "metrics", "BADJ_METRICS")) != NULL)
+    {
+        if (strcmp(value, "json") != 0)
+        {
+            fprintf(stderr, "Unknown metrics format: %s\n", value);
+            return 1;
+        }
+        g->metrics = 1;
+    }
+    if ((value = getsetting(argc, argv, "progress", "BADJ_PROGRESS")) != NULL)
+    {
+        // Report progress every 10 seconds unless given
+        g->progress = (*value == '\0') ? 10.0 : atof(value);
+    }
+    if ((value = getsetting(argc, argv, "affinity", "BADJ_AFFINITY")) != NULL)
+    {
+        g->affinity = (*value == '\0' || atoi(value) != 0);
+    }
+    if ((value = getsetting(argc, argv, "prefetch", "BADJ_PREFETCH")) != NULL)
+    {
+        g->prefetch = atoi(value);
+    }
+    else
+    {
+        // Prefetch one block per thread ahead by default
+        g->prefetch = g->nthreads;
+    }
+
+    // Check settings
+    if (g->nthreads < 1)
+    {
+        fprintf(stderr, "Number of threads must be positive.\n");
+        return 1;
+    }
+    if (g->blocklen < sizeof(unsigned int) || g->blocklen % sizeof(unsigned int) != 0)
+    {
+        fprintf(stderr, "Block length must be a positive multiple of %zu bytes.\n", sizeof(unsigned int));
+        return 1;
+    }
+    if ((g->align & (g->align - 1)) != 0 || g->align > (unsigned long long) sysconf(_SC_PAGESIZE))
+    {
+        fprintf(stderr, "Direct read alignment must be a power of two of at most %ld bytes.\n", sysconf(_SC_PAGESIZE));
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Get whether a graph file name has the extension of a format with 64-bit
+ * node numbers and degrees (.badj64, .cbadj64, .wbadj64, or .qbadj64). */
+int iswide(char *filename)
+{
+    size_t len = strlen(filename);
+    return (len >= 7 && strcmp(filename + len - 7, ".badj64") == 0)
+        || (len >= 8 && strcmp(filename + len - 8, ".cbadj64") == 0)
+        || (len >= 8 && strcmp(filename + len - 8, ".wbadj64") == 0)
+        || (len >= 8 && strcmp(filename + len - 8, ".qbadj64") == 0);
+}
+
+/* Get the bytes of edge weights of the format of a graph file name:
+ * 4 for float weights (.wbadj or .wbadj64), 2 for 16-bit weights
+ * (.qbadj or .qbadj64), or 0 for unweighted formats. */
+unsigned int weightlen(char *filename)
+{
+    size_t len = strlen(filename);
+    if ((len >= 6 && strcmp(filename + len - 6, ".wbadj") == 0)
+     || (len >= 8 && strcmp(filename + len - 8, ".wbadj64") == 0))
+    {
+        return sizeof(float);
+    }
+    if ((len >= 6 && strcmp(filename + len - 6, ".qbadj") == 0)
+     || (len >= 8 && strcmp(filename + len - 8, ".qbadj64") == 0))
+    {
+        return sizeof(unsigned short);
+    }
+    return 0;
+}
+
+/* Check that an output file name has the extension of the format being
+ * written: unweighted BADJ, or CBADJ if compressed is set, with 64-bit node
+ * numbers if the graph has them. Readers choose the format from the
+ * extension, so a mismatch would make the file unreadable. */
+int checkoutput(graph *g, char *filename, char compressed)
+{
+    char *ext = compressed ? (g->wide ? ".cbadj64" : ".cbadj") : (g->wide ? ".badj64" : ".badj");
+    size_t len = strlen(filename);
+    size_t extlen = strlen(ext);
+    if (len < extlen || strcmp(filename + len - extlen, ext) != 0)
+    {
+        fprintf(stderr, "Output file must have the extension %s.\n", ext);
+        return 1;
+    }
+
+    return 0;
+}
+
 /* Initialize graph. */
 int initialize(graph *g, char *filename, char badji)
 {
     // Set number of threads
-    omp_set_num_threads(NTHREADS);
+    omp_set_num_threads(g->nthreads);
+
+    // Start metrics
+    g->initialized = omp_get_wtime();
+    g->counts = NULL;
+    g->passes = NULL;
+    g->npasses = 0;
+    g->passcapacity = 0;
 
     // Check graph file name length
     if (strlen(filename) > FILENAMELEN)
@@ -13,9 +306,9 @@ int initialize(graph *g, char *filename, char badji)
         return 1;
     }
 
-    // Open graph file
+    // Open graph file, or read standard input for "-"
     strcpy(g->filename, filename);
-    g->stream = fopen(g->filename, "r");
+    g->stream = (strcmp(g->filename, "-") == 0) ? stdin : fopen(g->filename, "r");
 
     // Check file stream
     if (g->stream == NULL)
@@ -24,23 +317,44 @@ int initialize(graph *g, char *filename, char badji)
         return 1;
     }
 
+    // Detect compressed format, width of node numbers, and weights from file name
+    size_t len = strlen(g->filename);
+    g->compressed = (len >= 6 && strcmp(g->filename + len - 6, ".cbadj") == 0)
+                 || (len >= 8 && strcmp(g->filename + len - 8, ".cbadj64") == 0);
+    g->wide = iswide(g->filename);
+    g->idlen = g->wide ? sizeof(unsigned long long) : sizeof(unsigned int);
+    g->wlen = weightlen(g->filename);
+
     // Get numbers of nodes and edges
     fread(&g->n, sizeof(unsigned long long), 1, g->stream);
     fread(&g->m, sizeof(unsigned long long), 1, g->stream);
     
     // Check number of nodes
-    if (g->n > MAXNODES)
+    if (!g->wide && g->n > MAXNODES)
     {
-        fprintf(stderr, "Too many nodes to handle: %llu\n", g->n);
+        fprintf(stderr, "Too many nodes for 32-bit node numbers: %llu. Use the BADJ64 format.\n", g->n);
         return 1;
     }
 
+    // Keep direct reads of 64-bit node numbers aligned
+    if (g->wide && g->align != 0 && g->align < sizeof(unsigned long long))
+    {
+        g->align = sizeof(unsigned long long);
+    }
+
     // Check for badji file
     g->badji = badji;
     
     // If graph has badji file
     if (g->badji)
     {
+        // Check that graph is a file that blocks can be read from
+        if (g->stream == stdin)
+        {
+            fprintf(stderr, "Graph on standard input cannot be read in blocks.\n");
+            return 1;
+        }
+
         // Open badji file
         char badjiname[FILENAMELEN];
         strcpy(badjiname, g->filename);
@@ -58,33 +372,155 @@ int initialize(graph *g, char *filename, char badji)
         fread(&g->nblks, sizeof(unsigned long long), 1, badjistream);
         g->indices = malloc(g->nblks * sizeof(unsigned long long));
         fread(g->indices, sizeof(unsigned long long), g->nblks, badjistream);
-        g->firstnodes = malloc(g->nblks * sizeof(unsigned int));
-        fread(g->firstnodes, sizeof(unsigned int), g->nblks, badjistream);
+        g->firstnodes = malloc(g->nblks * sizeof(unsigned long long));
+        readids(badjistream, g->firstnodes, g->nblks, g->idlen);
+
+        // Get edge counts, byte sizes, and checksums of blocks if present
+        char magic[8];
+        g->blkedges = NULL;
+        g->blkbytes = NULL;
+        g->blksums = NULL;
+        if (fread(magic, 1, 8, badjistream) == 8 && memcmp(magic, BADJIEXTMAGIC, 8) == 0)
+        {
+            g->blkedges = malloc(g->nblks * sizeof(unsigned long long));
+            g->blkbytes = malloc(g->nblks * sizeof(unsigned long long));
+            g->blksums = malloc(g->nblks * sizeof(unsigned long long));
+            if (fread(g->blkedges, sizeof(unsigned long long), g->nblks, badjistream) != g->nblks
+                || fread(g->blkbytes, sizeof(unsigned long long), g->nblks, badjistream) != g->nblks
+                || fread(g->blksums, sizeof(unsigned long long), g->nblks, badjistream) != g->nblks)
+            {
+                fprintf(stderr, "Badji file is truncated.\n");
+                return 1;
+            }
+        }
         
         // Close badji file
         fclose(badjistream);
 
-        if (g->nblks < NTHREADS)
+        // Check number of blocks
+        if (g->nblks > g->maxblks)
+        {
+            fprintf(stderr, "Too many blocks to handle: %llu\n", g->nblks);
+            return 1;
+        }
+
+        // Get length of graph file and longest block
+        struct stat st;
+        if (fstat(fileno(g->stream), &st) != 0)
         {
-            fprintf(stderr, "Too many threads for too small a graph.\n");
+            fprintf(stderr, "Could not get length of BADJ file.\n");
             return 1;
         }
+        g->filelen = st.st_size;
+        g->maxblocklen = 0;
+        unsigned long long b;
+        for (b = 0; b < g->nblks; b++)
+        {
+            if (blockend(g, b) - g->indices[b] > g->maxblocklen)
+            {
+                g->maxblocklen = blockend(g, b) - g->indices[b];
+            }
+        }
+
+        // Map graph file unless disabled or reading directly
+        g->map = NULL;
+        if (g->usemap && g->align == 0 && g->filelen > 0)
+        {
+            g->map = mmap(NULL, g->filelen, PROT_READ, MAP_SHARED, fileno(g->stream), 0);
+            if (g->map == MAP_FAILED)
+            {
+                // Fall back to reading the file
+                g->map = NULL;
+            }
+            else
+            {
+                madvise(g->map, g->filelen, MADV_SEQUENTIAL);
+            }
+        }
+
+        // Open graph file again for reads that bypass the page cache
+        g->directfd = -1;
+        g->blockbuflen = g->maxblocklen;
+        if (g->align != 0)
+        {
+            g->directfd = open(g->filename, O_RDONLY | O_DIRECT);
+            if (g->directfd < 0)
+            {
+                fprintf(stderr, "Could not open BADJ file for direct reads.\n");
+                return 1;
+            }
+
+            // Leave room to round blocks out to the alignment on both ends
+            g->blockbuflen = (g->maxblocklen + 2 * g->align + HUGEPAGELEN - 1) / HUGEPAGELEN * HUGEPAGELEN;
+        }
+
+        // Allocate per-thread state
+        g->blockbuf = malloc(g->nthreads * sizeof(char *));
+        g->currblockno = malloc(g->nthreads * sizeof(unsigned long long));
+        g->currnode = malloc(g->nthreads * sizeof(unsigned long long));
+        g->currptr = malloc(g->nthreads * sizeof(char *));
+        g->buf = malloc(g->nthreads * sizeof(char *));
+        g->buflen = malloc(g->nthreads * sizeof(unsigned long long));
+        g->started = malloc(g->nthreads * sizeof(double));
+        g->finished = malloc(g->nthreads * sizeof(double));
+        g->busy = malloc(g->nthreads * sizeof(double));
+        g->idle = malloc(g->nthreads * sizeof(double));
+        g->counts = aligned_alloc(sizeof(counters), g->nthreads * sizeof(counters));
+        g->passbusy = malloc(g->nthreads * sizeof(double));
+        g->ownblks = malloc((g->nthreads + 1) * sizeof(unsigned long long));
+        g->cursors = aligned_alloc(sizeof(cursor), g->nthreads * sizeof(cursor));
+        memset(g->counts, 0, g->nthreads * sizeof(counters));
 
         // Initialize blocks
+        g->active = NULL;
+        g->nextblk = 0;
+        g->inpass = 0;
+        unsigned long long work = 0;
+        b = 0;
         unsigned int i;
-        for (i = 0; i < NTHREADS; i++)
+        for (i = 0; i < g->nthreads; i++)
         {
-            // Open file for block
-            g->currblock[i] = fopen(g->filename, "r");
-            g->currblockno[i] = i - NTHREADS + 1;
+            // Give each thread a contiguous range of blocks, with about as
+            // many edges plus nodes as the others if the badji file counts
+            // edges, or else the blocks starting in an equal range of nodes
+            if (g->blkedges != NULL)
+            {
+                unsigned long long target = i * ((g->m + g->n) / g->nthreads);
+                while (b < g->nblks && work < target)
+                {
+                    work += g->blkedges[b] + (blockfirst(g, b + 1) - g->firstnodes[b]);
+                    b++;
+                }
+            }
+            else
+            {
+                unsigned long long first = i * g->n / g->nthreads;
+                while (b < g->nblks && g->firstnodes[b] < first)
+                {
+                    b++;
+                }
+            }
+            g->ownblks[i] = b;
+
+            g->currblockno[i] = 0;
+            g->busy[i] = 0.0;
+            g->idle[i] = 0.0;
+            g->buf[i] = NULL;
+            g->buflen[i] = 0;
 
-            // Check file stream        
-            if (g->currblock[i] == NULL)
+            // Allocate block buffer if graph is not mapped
+            g->blockbuf[i] = NULL;
+            if (g->map == NULL)
             {
-                fprintf(stderr, "Could not open BADJ file.\n");
-                return 1;
+                g->blockbuf[i] = allocblockbuf(g);
+                if (g->blockbuf[i] == NULL)
+                {
+                    fprintf(stderr, "Could not allocate block buffer.\n");
+                    return 1;
+                }
             }
         }
+        g->ownblks[g->nthreads] = g->nblks;
     }
 
     return 0;
@@ -93,6 +529,12 @@ int initialize(graph *g, char *filename, char badji)
 /* Destroy graph. */
 int destroy(graph *g)
 {
+    // Print metrics
+    if (g->metrics)
+    {
+        printmetrics(g);
+    }
+
     // Close graph file
     fclose(g->stream);
 
@@ -101,133 +543,781 @@ int destroy(graph *g)
     {
         // Destroy blocks
         unsigned int i;
-        for (i = 0; i < NTHREADS; i++)
+        for (i = 0; i < g->nthreads; i++)
+        {
+            // Free buffers
+            if (g->blockbuf[i] != NULL && g->align != 0)
+            {
+                munmap(g->blockbuf[i], g->blockbuflen);
+            }
+            else
+            {
+                free(g->blockbuf[i]);
+            }
+            free(g->buf[i]);
+        }
+
+        // Unmap graph file
+        if (g->map != NULL)
         {
-            // Close file for block
-            fclose(g->currblock[i]);
+            munmap(g->map, g->filelen);
         }
+
+        // Close file for direct reads
+        if (g->directfd >= 0)
+        {
+            close(g->directfd);
+        }
+
+        // Free block indices, first nodes, and block statistics
+        free(g->indices);
+        free(g->firstnodes);
+        free(g->blkedges);
+        free(g->blkbytes);
+        free(g->blksums);
+
+        // Free per-thread state
+        free(g->blockbuf);
+        free(g->currblockno);
+        free(g->currnode);
+        free(g->currptr);
+        free(g->buf);
+        free(g->buflen);
+        free(g->started);
+        free(g->finished);
+        free(g->busy);
+        free(g->idle);
+        free(g->counts);
+        free(g->passbusy);
+        free(g->ownblks);
+        free(g->cursors);
+        free(g->passes);
     }
 
     return 0;
 }
 
-/* Transpose a BADJ graph. */
+/* Transpose a BADJ graph in memory, in parallel over its blocks. */
 int transpose(graph *g, char *filename)
 {
-    // Allocate space for degrees in transpose
-    unsigned int *degt = malloc(sizeof(unsigned int) * g->n);
-    unsigned int *currdegt = malloc(sizeof(unsigned int) * g->n);
-    unsigned int i;
-    for (i = 0; i < g->n; i++)
+    // Test for badji file
+    if (!g->badji)
     {
-        degt[i] = 0;
-        currdegt[i] = 0;
+        fprintf(stderr, "Graph must have a badji file.\n");
+        return 1;
     }
 
-    // For each node
-    unsigned int deg;
-    unsigned int *adj;
-    for (i = 0; i < g->n; i++)
+    // Test for unweighted graph
+    if (g->wlen != 0)
     {
-        // Read adjacency list
-        fread(&deg, sizeof(unsigned int), 1, g->stream);
-        adj = malloc(sizeof(unsigned int) * deg);
-        fread(adj, sizeof(unsigned int), deg, g->stream);
+        fprintf(stderr, "Weighted graphs are not supported.\n");
+        return 1;
+    }
 
-        // Increment degrees in transpose
-        unsigned int j;
-        for (j = 0; j < deg; j++)
+    // Test that output file name has the extension of the format written
+    if (checkoutput(g, filename, 0))
+    {
+        return 1;
+    }
+
+    // Split blocks into contiguous ranges, one per thread, but use fewer
+    // ranges if their degree histograms, 4 bytes per node each, would take
+    // more memory than the transpose itself, as for sparse graphs on many
+    // threads
+    unsigned int nparts = g->nthreads;
+    unsigned long long maxparts = (g->n + g->m) * g->idlen / (g->n * sizeof(unsigned int) + 1);
+    if (nparts > maxparts)
+    {
+        nparts = (maxparts > 0) ? maxparts : 1;
+    }
+
+    // Allocate degree histograms of ranges and positions of adjacency lists in transpose
+    unsigned int *hist = calloc((unsigned long long) nparts * g->n, sizeof(unsigned int));
+    unsigned long long *start = malloc((g->n + 1) * sizeof(unsigned long long));
+    if (hist == NULL || start == NULL)
+    {
+        fprintf(stderr, "Could not allocate degree histograms.\n");
+        free(hist);
+        free(start);
+        return 1;
+    }
+
+    // Count degrees in transpose
+    unsigned int t;
+    #pragma omp parallel for schedule(static, 1)
+    for (t = 0; t < nparts; t++)
+    {
+        unsigned int threadno = omp_get_thread_num();
+        unsigned int *histt = hist + (unsigned long long) t * g->n;
+
+        // For each block in range
+        unsigned long long b;
+        for (b = t * g->nblks / nparts; b < (t + 1) * g->nblks / nparts; b++)
         {
-            degt[adj[j]]++;
+            seekblock(g, threadno, b);
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Increment degrees in histogram
+                unsigned long long j;
+                for (j = 0; j < v.deg; j++)
+                {
+                    histt[neighbor(&v, j)]++;
+                }
+            }
         }
-        free(adj);
     }
 
-    // Allocate space for adjacency list in transpose
-    unsigned int **adjt = malloc(sizeof(unsigned int *) * g->n);
-    for (i = 0; i < g->n; i++)
+    // Merge histograms, turning each count into the offset of the
+    // range's first edge within the node's adjacency list in transpose
+    long long v;
+    #pragma omp parallel for
+    for (v = 0; v < g->n; v++)
     {
-        adjt[i] = malloc(sizeof(unsigned int) * degt[i]);
+        unsigned int degt = 0;
+        unsigned int p;
+        for (p = 0; p < nparts; p++)
+        {
+            unsigned int count = hist[(unsigned long long) p * g->n + v];
+            hist[(unsigned long long) p * g->n + v] = degt;
+            degt += count;
+        }
+        start[v] = 1 + (unsigned long long) degt;
     }
 
-    // Rewind graph
-    fseek(g->stream, 2*sizeof(unsigned long long), SEEK_SET);
+    // Prefix sum node lengths into positions of adjacency lists
+    unsigned long long *partsums = calloc(nparts + 1, sizeof(unsigned long long));
+    if (partsums == NULL)
+    {
+        fprintf(stderr, "Could not allocate degree histograms.\n");
+        free(hist);
+        free(start);
+        return 1;
+    }
+    #pragma omp parallel for schedule(static, 1)
+    for (t = 0; t < nparts; t++)
+    {
+        unsigned long long sum = 0;
+        unsigned long long u;
+        for (u = t * g->n / nparts; u < (t + 1) * g->n / nparts; u++)
+        {
+            unsigned long long len = start[u];
+            start[u] = sum;
+            sum += len;
+        }
+        partsums[t+1] = sum;
+    }
+    for (t = 0; t < nparts; t++)
+    {
+        partsums[t+1] += partsums[t];
+    }
+    #pragma omp parallel for schedule(static, 1)
+    for (t = 0; t < nparts; t++)
+    {
+        unsigned long long u;
+        for (u = t * g->n / nparts; u < (t + 1) * g->n / nparts; u++)
+        {
+            start[u] += partsums[t];
+        }
+    }
+    start[g->n] = partsums[nparts];
+    free(partsums);
 
-    // For each node
-    for (i = 0; i < g->n; i++)
+    // Allocate transpose in BADJ layout
+    void *adjt = malloc(start[g->n] * g->idlen);
+    if (adjt == NULL)
     {
-        // Read adjacency list
-        fread(&deg, sizeof(unsigned int), 1, g->stream);
-        adj = malloc(sizeof(unsigned int) * deg);
-        fread(adj, sizeof(unsigned int), deg, g->stream);
+        fprintf(stderr, "Could not allocate transpose.\n");
+        free(hist);
+        free(start);
+        return 1;
+    }
 
-        // Update adjacency list in transpose
-        unsigned int j;
-        for (j = 0; j < deg; j++)
+    // Scatter edges into transpose
+    #pragma omp parallel for schedule(static, 1)
+    for (t = 0; t < nparts; t++)
+    {
+        unsigned int threadno = omp_get_thread_num();
+        unsigned int *histt = hist + (unsigned long long) t * g->n;
+
+        // For each block in range
+        unsigned long long b;
+        for (b = t * g->nblks / nparts; b < (t + 1) * g->nblks / nparts; b++)
         {
-            adjt[adj[j]][currdegt[adj[j]]] = i;
-            currdegt[adj[j]]++;
+            seekblock(g, threadno, b);
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Update adjacency lists in transpose
+                unsigned long long j;
+                for (j = 0; j < v.deg; j++)
+                {
+                    unsigned long long vadjj = neighbor(&v, j);
+                    setid(adjt, start[vadjj] + 1 + histt[vadjj], i, g->idlen);
+                    histt[vadjj]++;
+                }
+            }
         }
-        free(adj);
+    }
+    free(hist);
+
+    // Set degrees in transpose
+    #pragma omp parallel for
+    for (v = 0; v < g->n; v++)
+    {
+        setid(adjt, start[v], start[v+1] - start[v] - 1, g->idlen);
     }
 
     // Create BADJ file
     FILE *out = fopen(filename, "w");
-    fwrite(&g->n, sizeof(unsigned long long), 1, out);
-    fwrite(&g->m, sizeof(unsigned long long), 1, out);
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open file.\n");
+        free(adjt);
+        free(start);
+        return 1;
+    }
 
-    // For each node
-    for (i = 0; i < g->n; i++)
+    // Write transpose in one sequential write
+    char failed = 0;
+    failed |= (fwrite(&g->n, sizeof(unsigned long long), 1, out) != 1);
+    failed |= (fwrite(&g->m, sizeof(unsigned long long), 1, out) != 1);
+    failed |= (fwrite(adjt, g->idlen, start[g->n], out) != start[g->n]);
+    failed |= (fclose(out) != 0);
+    if (failed)
+    {
+        fprintf(stderr, "Could not write transposed graph.\n");
+        remove(filename);
+        free(adjt);
+        free(start);
+        return 1;
+    }
+
+    // Write badji file
+    indexer ix;
+    initindex(&ix, g);
+    for (v = 0; v < g->n; v++)
     {
-        // Write degree and adjacent nodes in transpose
-        fwrite(&degt[i], sizeof(unsigned int), 1, out);
-        fwrite(adjt[i], sizeof(unsigned int), degt[i], out);
+        indexnode(&ix, (start[v+1] - start[v]) * g->idlen, getid(adjt, start[v], g->idlen));
+        indexdata(&ix, (char *) adjt + start[v] * g->idlen, (start[v+1] - start[v]) * g->idlen);
     }
+    char badjiname[FILENAMELEN + 1];
+    strcpy(badjiname, filename);
+    strcat(badjiname, "i");
+    int ret = writeindex(&ix, badjiname);
 
     // Clean up
-    fclose(out);
-    free(degt);
-    free(currdegt);
     free(adjt);
+    free(start);
 
-    return 0;
+    return ret;
 }
 
-/* Compute the locality of a BADJ graph. */
-int locality(graph *g, unsigned int window, double *loc)
+/* Transpose a BADJ graph using at most about memory bytes
+ * by partitioning edges by destination into bucket files. */
+int transposeooc(graph *g, char *filename, unsigned long long memory)
 {
-    // Initialize number of local references
-    unsigned int refs = 0;
+    // Test for uncompressed graph
+    if (g->compressed)
+    {
+        fprintf(stderr, "Graph must be in uncompressed BADJ format.\n");
+        return 1;
+    }
+
+    // Test for unweighted graph
+    if (g->wlen != 0)
+    {
+        fprintf(stderr, "Weighted graphs are not supported.\n");
+        return 1;
+    }
+
+    // Test that output file name has the extension of the format written
+    if (checkoutput(g, filename, 0))
+    {
+        return 1;
+    }
+
+    // Test that graph can be read more than once, which a pipe cannot
+    if (fseeko(g->stream, 2*sizeof(unsigned long long), SEEK_SET) != 0)
+    {
+        fprintf(stderr, "Graph must be a file that can be read more than once, not standard input.\n");
+        return 1;
+    }
+
+    // Check memory budget against in-degrees
+    unsigned long long degtlen = g->n * g->idlen;
+    if (memory <= degtlen)
+    {
+        fprintf(stderr, "Memory budget too small for %llu nodes.\n", g->n);
+        return 1;
+    }
+    unsigned long long bucketmem = memory - degtlen;
+
+    // Keep as many bucket files open at once as file descriptors allow,
+    // leaving some for the graph and output, with their stream buffers
+    // taking at most an eighth of the rest of the budget, splitting edges
+    // into buckets in rounds, and size buckets within what remains
+    long maxfiles = sysconf(_SC_OPEN_MAX);
+    unsigned long long maxopen = (maxfiles > 32) ? maxfiles - 16 : maxfiles / 2;
+    if (maxopen > bucketmem / (8 * BUFSIZ))
+    {
+        maxopen = (bucketmem / (8 * BUFSIZ) > 0) ? bucketmem / (8 * BUFSIZ) : 1;
+    }
+    if (bucketmem <= maxopen * BUFSIZ)
+    {
+        fprintf(stderr, "Memory budget too small for %llu nodes.\n", g->n);
+        return 1;
+    }
+    bucketmem -= maxopen * BUFSIZ;
+
+    // Count degrees in transpose, held as node numbers are
+    void *degt = calloc(g->n, g->idlen);
+    if (degt == NULL)
+    {
+        fprintf(stderr, "Could not allocate degrees in transpose.\n");
+        return 1;
+    }
+    unsigned long long buflen = 0;
+    void *buf = NULL;
+    unsigned long long deg;
+    unsigned long long i;
+    for (i = 0; i < g->n; i++)
+    {
+        // Read adjacency list
+        deg = readnode(g, &buf, &buflen);
+
+        // Increment degrees in transpose
+        unsigned long long j;
+        for (j = 0; j < deg; j++)
+        {
+            unsigned long long dst = getid(buf, j, g->idlen);
+            setid(degt, dst, getid(degt, dst, g->idlen) + 1, g->idlen);
+        }
+    }
+
+    // Split destinations into buckets whose adjacency lists and cursors fit in memory
+    int ret = 0;
+    unsigned long long nbuckets = 0;
+    unsigned long long capacity = 1024;
+    unsigned long long *firstdests = malloc((capacity + 1) * sizeof(unsigned long long));
+    unsigned long long bucketlen = 0;
+    firstdests[0] = 0;
+    for (i = 0; i < g->n; i++)
+    {
+        unsigned long long nodelen = getid(degt, i, g->idlen) * g->idlen + sizeof(unsigned long long);
+        if (nodelen > bucketmem)
+        {
+            fprintf(stderr, "Memory budget too small for node %llu.\n", i);
+            ret = 1;
+            break;
+        }
+        if (bucketlen + nodelen > bucketmem)
+        {
+            nbuckets++;
+            if (nbuckets == capacity)
+            {
+                capacity *= 2;
+                firstdests = realloc(firstdests, (capacity + 1) * sizeof(unsigned long long));
+            }
+            firstdests[nbuckets] = i;
+            bucketlen = 0;
+        }
+        bucketlen += nodelen;
+    }
+    nbuckets++;
+    firstdests[nbuckets] = g->n;
+
+    // Create BADJ file
+    FILE *out = NULL;
+    char failed = 0;
+    if (!ret && (out = fopen(filename, "w")) == NULL)
+    {
+        fprintf(stderr, "Could not open file.\n");
+        ret = 1;
+    }
+    if (!ret)
+    {
+        failed |= (fwrite(&g->n, sizeof(unsigned long long), 1, out) != 1);
+        failed |= (fwrite(&g->m, sizeof(unsigned long long), 1, out) != 1);
+    }
+
+    // Start badji file
+    indexer ix;
+    initindex(&ix, g);
+
+    // For each round of buckets
+    FILE **buckets = calloc(maxopen, sizeof(FILE *));
+    char bucketname[FILENAMELEN + 32];
+    unsigned long long pairs[2048];
+    unsigned long long round;
+    for (round = 0; !ret && !failed && round < nbuckets; round += maxopen)
+    {
+        unsigned long long nround = (nbuckets - round < maxopen) ? nbuckets - round : maxopen;
+        unsigned long long k;
+
+        // Open bucket files of round
+        for (k = 0; k < nround && !ret; k++)
+        {
+            sprintf(bucketname, "%s.%llu.tmp", filename, round + k);
+            buckets[k] = fopen(bucketname, "w+");
+            if (buckets[k] == NULL)
+            {
+                fprintf(stderr, "Could not open bucket file.\n");
+                ret = 1;
+            }
+            else
+            {
+                // Fix the stream buffer to the size counted against the budget
+                setvbuf(buckets[k], NULL, _IOFBF, BUFSIZ);
+            }
+        }
+
+        // Rewind graph
+        if (!ret && fseeko(g->stream, 2*sizeof(unsigned long long), SEEK_SET) != 0)
+        {
+            fprintf(stderr, "Could not rewind graph.\n");
+            ret = 1;
+        }
+
+        // Write each edge into the round as a (source, destination) pair to the bucket of its destination
+        for (i = 0; i < g->n && !ret && !failed; i++)
+        {
+            // Read adjacency list
+            deg = readnode(g, &buf, &buflen);
+
+            unsigned long long j;
+            for (j = 0; j < deg && !failed; j++)
+            {
+                // Skip destinations outside the round
+                unsigned long long dst = getid(buf, j, g->idlen);
+                if (dst < firstdests[round] || dst >= firstdests[round+nround])
+                {
+                    continue;
+                }
+
+                // Find bucket of destination
+                unsigned long long lo = round, hi = round + nround;
+                while (hi - lo > 1)
+                {
+                    unsigned long long mid = (lo + hi) / 2;
+                    if (firstdests[mid] <= dst)
+                    {
+                        lo = mid;
+                    }
+                    else
+                    {
+                        hi = mid;
+                    }
+                }
+
+                unsigned long long pair[2];
+                setid(pair, 0, i, g->idlen);
+                setid(pair, 1, dst, g->idlen);
+                failed |= (fwrite(pair, g->idlen, 2, buckets[lo-round]) != 2);
+            }
+        }
+
+        // For each bucket of round
+        for (k = 0; k < nround && !ret && !failed; k++)
+        {
+            // Find positions of adjacency lists in bucket
+            unsigned long long first = firstdests[round+k];
+            unsigned long long last = firstdests[round+k+1];
+            unsigned long long *currdegt = malloc((last - first) * sizeof(unsigned long long));
+            unsigned long long nedges = 0;
+            for (i = first; currdegt != NULL && i < last; i++)
+            {
+                currdegt[i-first] = nedges;
+                nedges += getid(degt, i, g->idlen);
+            }
+            void *adjt = malloc(nedges * g->idlen);
+            if (currdegt == NULL || (adjt == NULL && nedges != 0))
+            {
+                fprintf(stderr, "Could not allocate bucket.\n");
+                free(currdegt);
+                free(adjt);
+                ret = 1;
+                break;
+            }
+
+            // Place sources into adjacency lists, which stay sorted
+            // because sources were written in increasing order
+            failed |= (fflush(buckets[k]) != 0);
+            rewind(buckets[k]);
+            unsigned int pairsread;
+            while ((pairsread = fread(pairs, 2 * g->idlen, 1024, buckets[k])) > 0)
+            {
+                unsigned int p;
+                for (p = 0; p < pairsread; p++)
+                {
+                    setid(adjt, currdegt[getid(pairs, 2*p+1, g->idlen) - first]++, getid(pairs, 2*p, g->idlen), g->idlen);
+                }
+            }
+
+            // Write degrees and adjacent nodes in transpose
+            char *adjti = adjt;
+            for (i = first; i < last && !failed; i++)
+            {
+                char *degti = (char *) degt + i * g->idlen;
+                unsigned long long degi = getid(degt, i, g->idlen);
+                failed |= (fwrite(degti, g->idlen, 1, out) != 1);
+                failed |= (fwrite(adjti, g->idlen, degi, out) != degi);
+                indexnode(&ix, (1 + degi) * g->idlen, degi);
+                indexdata(&ix, degti, g->idlen);
+                indexdata(&ix, adjti, degi * g->idlen);
+                adjti += degi * g->idlen;
+            }
+            free(currdegt);
+            free(adjt);
+
+            // Remove bucket file
+            fclose(buckets[k]);
+            buckets[k] = NULL;
+            sprintf(bucketname, "%s.%llu.tmp", filename, round + k);
+            remove(bucketname);
+        }
+
+        // Remove bucket files of round left by an error
+        for (k = 0; k < nround; k++)
+        {
+            if (buckets[k] != NULL)
+            {
+                fclose(buckets[k]);
+                buckets[k] = NULL;
+                sprintf(bucketname, "%s.%llu.tmp", filename, round + k);
+                remove(bucketname);
+            }
+        }
+    }
+    free(buf);
+
+    // Finish BADJ file
+    if (out != NULL)
+    {
+        failed |= (fclose(out) != 0);
+    }
+    if (failed && !ret)
+    {
+        fprintf(stderr, "Could not write transposed graph.\n");
+        ret = 1;
+    }
+
+    // Write badji file, or remove the partial graph and badji file on error
+    char badjiname[FILENAMELEN + 1];
+    strcpy(badjiname, filename);
+    strcat(badjiname, "i");
+    if (!ret)
+    {
+        ret = writeindex(&ix, badjiname);
+    }
+    else
+    {
+        free(ix.indices);
+        free(ix.firstnodes);
+        free(ix.edges);
+        free(ix.bytes);
+        free(ix.checksums);
+    }
+    if (ret && out != NULL)
+    {
+        remove(filename);
+        remove(badjiname);
+    }
+
+    // Clean up
+    free(buckets);
+    free(firstdests);
+    free(degt);
+
+    return ret;
+}
+
+/* Compare two nodes for sorting. */
+static int comparenodes(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *) a;
+    unsigned int y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+/* Compare two 64-bit nodes for sorting. */
+static int comparenodes64(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *) a;
+    unsigned long long y = *(const unsigned long long *) b;
+    return (x > y) - (x < y);
+}
+
+/* Compress a BADJ graph into CBADJ format, gap-encoding sorted adjacency lists. */
+int compress(graph *g, char *filename)
+{
+    // Test for uncompressed graph
+    if (g->compressed)
+    {
+        fprintf(stderr, "Graph must be in uncompressed BADJ format.\n");
+        return 1;
+    }
+
+    // Test for unweighted graph
+    if (g->wlen != 0)
+    {
+        fprintf(stderr, "Weighted graphs are not supported.\n");
+        return 1;
+    }
+
+    // Test that output file name has the extension of the format written
+    if (checkoutput(g, filename, 1))
+    {
+        return 1;
+    }
+
+    // Create CBADJ file
+    FILE *out = fopen(filename, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open file.\n");
+        return 1;
+    }
+    char failed = 0;
+    failed |= (fwrite(&g->n, sizeof(unsigned long long), 1, out) != 1);
+    failed |= (fwrite(&g->m, sizeof(unsigned long long), 1, out) != 1);
+
+    // Start badji file
+    indexer ix;
+    initindex(&ix, g);
+
+    // For each node
+    unsigned long long buflen = 0;
+    void *adj = NULL;
+    unsigned long long codelen = 0;
+    unsigned char *code = NULL;
+    char nomem = 0;
+    unsigned long long i;
+    for (i = 0; i < g->n && !failed; i++)
+    {
+        // Read adjacency list, with room to encode it in up to 10 bytes per node number
+        unsigned long long deg = readnode(g, &adj, &buflen);
+        if (10 * (deg + 1) > codelen)
+        {
+            codelen = 10 * (deg + 1);
+            free(code);
+            code = malloc(codelen);
+            if (code == NULL)
+            {
+                nomem = 1;
+                break;
+            }
+        }
+
+        // Sort adjacency list if needed
+        unsigned long long j;
+        for (j = 1; j < deg && getid(adj, j-1, g->idlen) <= getid(adj, j, g->idlen); j++);
+        if (j < deg)
+        {
+            qsort(adj, deg, g->idlen, g->wide ? comparenodes64 : comparenodes);
+        }
+
+        // Encode degree, first neighbor relative to node, and gaps
+        unsigned long long len = putvarint(code, deg);
+        if (deg > 0)
+        {
+            long long first = (long long) (getid(adj, 0, g->idlen) - i);
+            len += putvarint(code + len, ((unsigned long long) first << 1) ^ (unsigned long long) (first >> 63));
+            for (j = 1; j < deg; j++)
+            {
+                len += putvarint(code + len, getid(adj, j, g->idlen) - getid(adj, j-1, g->idlen));
+            }
+        }
+
+        // Write node
+        failed |= (fwrite(code, 1, len, out) != len);
+        indexnode(&ix, len, deg);
+        indexdata(&ix, code, len);
+    }
+    failed |= (fclose(out) != 0);
+    free(adj);
+    free(code);
+    if (nomem || failed)
+    {
+        if (nomem)
+        {
+            fprintf(stderr, "Could not allocate adjacency list.\n");
+        }
+        else
+        {
+            fprintf(stderr, "Could not write compressed graph.\n");
+        }
+        remove(filename);
+        free(ix.indices);
+        free(ix.firstnodes);
+        free(ix.edges);
+        free(ix.bytes);
+        free(ix.checksums);
+        return 1;
+    }
+
+    // Write badji file
+    char badjiname[FILENAMELEN + 1];
+    strcpy(badjiname, filename);
+    strcat(badjiname, "i");
+    return writeindex(&ix, badjiname);
+}
+
+/* Compute the locality of a BADJ graph. */
+int locality(graph *g, unsigned int window, double *loc)
+{
+    // Test for uncompressed graph
+    if (g->compressed)
+    {
+        fprintf(stderr, "Graph must be in uncompressed BADJ format.\n");
+        return 1;
+    }
+
+    // Initialize number of local references
+    unsigned long long refs = 0;
 
     // Initialize previous node
-    unsigned int prev = ((unsigned int) - 1) / 2;
+    unsigned long long prev = ((unsigned int) - 1) / 2;
 
     // For each node
-    unsigned int deg;
-    unsigned int *adj;
-    unsigned int i;
+    unsigned long long buflen = 0;
+    void *adj = NULL;
+    unsigned long long i;
     for (i = 0; i < g->n; i++)
     {
         // Read adjacency list
-        fread(&deg, sizeof(unsigned int), 1, g->stream);
-        adj = malloc(sizeof(unsigned int) * deg);
-        fread(adj, sizeof(unsigned int), deg, g->stream);
+        unsigned long long deg = readnode(g, &adj, &buflen);
 
         // For each neighbor
-        unsigned int j;
+        unsigned long long j;
         for (j = 0; j < deg; j++)
         {
             // Increment number of local reference if node is within window
-            if (abs(adj[j] - prev) < window)
+            unsigned long long adjj = getid(adj, j, g->idlen);
+            if ((adjj > prev ? adjj - prev : prev - adjj) < window)
             {
                 refs++;
             }
             
             // Update previous node
-            prev = adj[j];
+            prev = adjj;
         }
-        free(adj);
     }
+    free(adj);
 
     // Find percentage of local references
     *loc = (double) refs / (double) (g->m - 1);
@@ -235,139 +1325,989 @@ int locality(graph *g, unsigned int window, double *loc)
     return 0;
 }
 
-/* Create a badji file for a BADJ graph. */
-int badjindex(graph *g)
+/* Create a badji file for a BADJ graph in one pass over the graph file,
+ * without seeking, so the graph may be read from a pipe as it is written.
+ * Degrees split between chunks are carried over to the next chunk. */
+int badjindex(graph *g, char *filename)
 { 
-    // Declare variables
-    unsigned long long nblks = 0;
-    unsigned int currnode = 0;
-    unsigned long long indices[MAXBLKS];
-    unsigned int firstnodes[MAXBLKS];
-   
-    // Initialize block
-    unsigned int *block = malloc(BLOCKLEN);
-
-    // For each block
-    while (1)
-    {
-        // Set block index and first node
-        indices[nblks] = ftello(g->stream);
-        firstnodes[nblks] = currnode;
-
-        // Read maximal block
-        unsigned int intsread = fread(block, sizeof(unsigned int), BLOCKLEN / sizeof(unsigned int), g->stream);
-        unsigned int blocklen = 0;
-        
-        // Check for end of file
-        if (intsread == 0)
-        {
-            break;
-        }
-        
-        // Increment the number of blocks
-        nblks++;
-        if (nblks > MAXBLKS)
-        {
-            fprintf(stderr, "Too many blocks to handle.\n");
-            return 1;
-        }
+    // Test for uncompressed graph
+    if (g->compressed)
+    {
+        fprintf(stderr, "Graph must be in uncompressed BADJ format.\n");
+        return 1;
+    }
 
-        // For each node
-        while (1)
+    // Start index
+    indexer ix;
+    initindex(&ix, g);
+    unsigned char *chunk = malloc(INDEXCHUNKLEN);
+    unsigned long long degbuf;
+    unsigned int degbytes = 0;
+    unsigned long long need = 0;
+
+    // For each chunk of the graph file
+    unsigned long long chunklen;
+    int ret = 0;
+    while (!ret && (chunklen = fread(chunk, 1, INDEXCHUNKLEN, g->stream)) > 0)
+    {
+        unsigned long long pos = 0;
+        while (pos < chunklen)
         {
-            // Get degree
-            unsigned int deg = block[blocklen];
+            // Add rest of current adjacency list to block checksum
+            if (need > 0)
+            {
+                unsigned long long len = (need < chunklen - pos) ? need : chunklen - pos;
+                indexdata(&ix, chunk + pos, len);
+                pos += len;
+                need -= len;
+                continue;
+            }
 
-            // Test whether node fits in block
-            if (blocklen + 1 + deg <= intsread)
+            // Assemble degree, which may continue from the last chunk
+            unsigned long long len = g->idlen - degbytes;
+            if (len > chunklen - pos)
             {
-                // If so, increment block length
-                blocklen = blocklen + 1 + deg;
-                currnode++;
+                len = chunklen - pos;
             }
-            else
+            memcpy((char *) &degbuf + degbytes, chunk + pos, len);
+            degbytes += len;
+            pos += len;
+            if (degbytes < g->idlen)
+            {
+                continue;
+            }
+            degbytes = 0;
+
+            // Add node to index
+            unsigned long long deg = getid(&degbuf, 0, g->idlen);
+            if (ix.node >= g->n)
             {
-                // Otherwise, unread node
-                int extra = intsread - blocklen;
-                fseek(g->stream, -extra*sizeof(unsigned int), SEEK_CUR);
+                fprintf(stderr, "Graph has more nodes than its header says.\n");
+                ret = 1;
                 break;
             }
+            indexnode(&ix, (1 + deg) * g->idlen + weightbytes(deg, g->wlen, g->idlen), deg);
+            indexdata(&ix, &degbuf, g->idlen);
+            need = deg * g->idlen + weightbytes(deg, g->wlen, g->idlen);
         }
     }
+    free(chunk);
 
-    // Create badji file
-    char filename[FILENAMELEN];
-    strcpy(filename, g->filename);
-    strcat(filename, "i");
-    FILE *out = (FILE *) fopen(filename, "w");
+    // Check that graph file ended after the last node
+    if (!ret && (need > 0 || degbytes > 0 || ix.node != g->n))
+    {
+        fprintf(stderr, "Graph file is truncated.\n");
+        ret = 1;
+    }
 
-    // Check file stream
-    if (out == NULL)
+    // Write badji file
+    if (ret)
     {
-        fprintf(stderr, "Could not open file.\n");
+        free(ix.indices);
+        free(ix.firstnodes);
+        free(ix.edges);
+        free(ix.bytes);
+        free(ix.checksums);
         return 1;
     }
+    return writeindex(&ix, filename);
+}
 
-    // Write number of blocks, block indices, and first nodes
-    fwrite(&nblks, sizeof(unsigned long long), 1, out);
-    fwrite(indices, sizeof(unsigned long long), nblks, out);
-    fwrite(firstnodes, sizeof(unsigned int), nblks, out);
-
-    // Close badji file
-    fclose(out);
+/* Read a permutation from original to new node numbers written by reorder,
+ * as wide as node numbers in the graph, into 64-bit node numbers. */
+unsigned long long *readperm(graph *g, char *filename)
+{
+    // Open permutation file
+    FILE *in = fopen(filename, "r");
+    if (in == NULL)
+    {
+        fprintf(stderr, "Could not open permutation file.\n");
+        return NULL;
+    }
 
-    // Free block
-    free(block);
+    // Read permutation, widening node numbers in place from the end
+    unsigned long long *perm = malloc(g->n * sizeof(unsigned long long));
+    if (perm == NULL)
+    {
+        fprintf(stderr, "Could not allocate permutation.\n");
+        fclose(in);
+        return NULL;
+    }
+    if (fread(perm, g->idlen, g->n, in) != g->n)
+    {
+        fprintf(stderr, "Permutation file is too short.\n");
+        free(perm);
+        fclose(in);
+        return NULL;
+    }
+    if (fgetc(in) != EOF)
+    {
+        fprintf(stderr, "Permutation file is too long, or of a different width than the graph.\n");
+        free(perm);
+        fclose(in);
+        return NULL;
+    }
+    fclose(in);
+    unsigned long long i;
+    for (i = g->n; i > 0; i--)
+    {
+        perm[i-1] = getid(perm, i - 1, g->idlen);
+        if (perm[i-1] >= g->n)
+        {
+            fprintf(stderr, "Permutation file has a node out of range.\n");
+            free(perm);
+            return NULL;
+        }
+    }
 
-    return 0;
+    return perm;
 }
 
-/* Get the next block of the graph. */
-int nextblock(graph *g, unsigned int threadno)
+/* Write a checkpoint of an iterative computation on a graph, holding the
+ * iteration reached and count values of size bytes each. The checkpoint
+ * is written to a temporary file that then replaces the previous one, so
+ * a crash while writing leaves the previous checkpoint intact. */
+int writecheckpoint(checkpoint *ck, graph *g, unsigned int iter, void *data, unsigned long long size, unsigned long long count)
 {
-    // Test for badji file
-    if (!g->badji)
+    // Create temporary checkpoint file
+    char tmpname[FILENAMELEN + 5];
+    if (strlen(ck->filename) > FILENAMELEN)
     {
-        fprintf(stderr, "Graph must have a badji file.\n");
+        fprintf(stderr, "Max file name length exceeded.\n");
         return 1;
     }
-
-    // Increment block number
-    g->currblockno[threadno] += NTHREADS;
-    if (g->currblockno[threadno] > g->nblks)
+    strcpy(tmpname, ck->filename);
+    strcat(tmpname, ".tmp");
+    FILE *out = fopen(tmpname, "w");
+    if (out == NULL)
     {
-        g->currblockno[threadno] = threadno + 1;
+        fprintf(stderr, "Could not open checkpoint file.\n");
+        return 1;
     }
 
-    // Set block file pointer
-    fseeko(g->currblock[threadno], g->indices[g->currblockno[threadno]-1], SEEK_SET);
+    // Write magic, kind, number of nodes, iteration, value size and count, and values
+    char kind[8] = {0};
+    memcpy(kind, ck->kind, strnlen(ck->kind, 8));
+    unsigned long long header[4] = {g->n, iter, size, count};
+    fwrite(CHECKPOINTMAGIC, 1, 8, out);
+    fwrite(kind, 1, 8, out);
+    fwrite(header, sizeof(unsigned long long), 4, out);
+    unsigned long long written = fwrite(data, size, count, out);
 
-    // Set current node
-    g->currnode[threadno] = g->firstnodes[g->currblockno[threadno]-1];
+    // Flush to disk before replacing previous checkpoint
+    int ret = (written != count || fflush(out) != 0 || fsync(fileno(out)) != 0);
+    fclose(out);
+    if (ret || rename(tmpname, ck->filename) != 0)
+    {
+        fprintf(stderr, "Could not write checkpoint file.\n");
+        remove(tmpname);
+        return 1;
+    }
 
     return 0;
 }
 
-/* Get the next node of the block. */
-unsigned int nextnode(graph *g, node *v, unsigned int threadno)
+/* Resume an iterative computation on a graph from a checkpoint, reading
+ * count values of size bytes each and setting the iteration to start from. */
+int readcheckpoint(checkpoint *ck, graph *g, void *data, unsigned long long size, unsigned long long count)
 {
-    // Test for badji file
-    if (!g->badji)
+    FILE *in = fopen(ck->filename, "r");
+    if (in == NULL)
     {
-        fprintf(stderr, "Graph must have a badji file.\n");
+        fprintf(stderr, "Could not open checkpoint file.\n");
         return 1;
     }
 
-    // If there is no next node
-    if ((g->currblockno[threadno] < g->nblks && g->currnode[threadno] == g->firstnodes[g->currblockno[threadno]]) || feof(g->currblock[threadno]))
+    // Check that checkpoint matches computation, graph, and values
+    char magic[8];
+    char kind[8];
+    char expected[8] = {0};
+    memcpy(expected, ck->kind, strnlen(ck->kind, 8));
+    unsigned long long header[4];
+    if (fread(magic, 1, 8, in) != 8 || memcmp(magic, CHECKPOINTMAGIC, 8) != 0
+        || fread(kind, 1, 8, in) != 8 || fread(header, sizeof(unsigned long long), 4, in) != 4)
+    {
+        fprintf(stderr, "Not a checkpoint file.\n");
+        fclose(in);
+        return 1;
+    }
+    if (memcmp(kind, expected, 8) != 0)
+    {
+        fprintf(stderr, "Checkpoint is not of %s.\n", ck->kind);
+        fclose(in);
+        return 1;
+    }
+    if (header[0] != g->n || header[2] != size || header[3] != count)
+    {
+        fprintf(stderr, "Checkpoint does not match graph.\n");
+        fclose(in);
+        return 1;
+    }
+
+    // Read values
+    if (fread(data, size, count, in) != count)
     {
-        return -1;
+        fprintf(stderr, "Checkpoint file is too short.\n");
+        fclose(in);
+        return 1;
     }
+    fclose(in);
+    ck->iter = header[1];
+    ck->init = 1;
+
+    return 0;
+}
+
+/* Start a badji file for a BADJ graph being written, using
+ * the block length and maximum number of blocks of g. */
+int initindex(indexer *ix, graph *g)
+{
+    ix->blocklen = g->blocklen;
+    ix->maxblks = g->maxblks;
+    ix->idlen = g->idlen;
+    ix->nblks = 0;
+    ix->capacity = 1024;
+    ix->indices = malloc(ix->capacity * sizeof(unsigned long long));
+    ix->firstnodes = malloc(ix->capacity * sizeof(unsigned long long));
+    ix->edges = malloc(ix->capacity * sizeof(unsigned long long));
+    ix->bytes = malloc(ix->capacity * sizeof(unsigned long long));
+    ix->checksums = malloc(ix->capacity * sizeof(unsigned long long));
+    ix->offset = 2*sizeof(unsigned long long);
+    ix->node = 0;
+
+    return 0;
+}
 
-    // Otherwise, read next node
-    fread(&v->deg, sizeof(unsigned int), 1, g->currblock[threadno]);
-    v->adj = malloc(v->deg * sizeof(unsigned int));
-    fread(v->adj, sizeof(unsigned int), v->deg, g->currblock[threadno]);
+/* Add a node of the given length in bytes and out-degree to a badji file
+ * being built. Its bytes are then passed to indexdata for the checksum. */
+int indexnode(indexer *ix, unsigned long long bytes, unsigned long long deg)
+{
+    // Start a new block if node does not fit in current block
+    if (ix->nblks == 0 || ix->offset + bytes > ix->indices[ix->nblks-1] + ix->blocklen)
+    {
+        // Grow block indices and first nodes if needed
+        if (ix->nblks == ix->capacity)
+        {
+            ix->capacity *= 2;
+            ix->indices = realloc(ix->indices, ix->capacity * sizeof(unsigned long long));
+            ix->firstnodes = realloc(ix->firstnodes, ix->capacity * sizeof(unsigned long long));
+            ix->edges = realloc(ix->edges, ix->capacity * sizeof(unsigned long long));
+            ix->bytes = realloc(ix->bytes, ix->capacity * sizeof(unsigned long long));
+            ix->checksums = realloc(ix->checksums, ix->capacity * sizeof(unsigned long long));
+        }
+
+        // Set block index and first node, and start block statistics
+        ix->indices[ix->nblks] = ix->offset;
+        ix->firstnodes[ix->nblks] = ix->node;
+        ix->edges[ix->nblks] = 0;
+        ix->bytes[ix->nblks] = 0;
+        ix->checksums[ix->nblks] = 0xcbf29ce484222325ULL;
+        ix->nblks++;
+    }
+
+    // Count node in block and advance to next node
+    ix->edges[ix->nblks-1] += deg;
+    ix->bytes[ix->nblks-1] += bytes;
+    ix->offset += bytes;
+    ix->node++;
+
+    return 0;
+}
+
+/* Add bytes of the last node added to a badji file being built to the
+ * checksum of its block. */
+int indexdata(indexer *ix, void *data, unsigned long long len)
+{
+    ix->checksums[ix->nblks-1] = checksum(ix->checksums[ix->nblks-1], data, len);
+
+    return 0;
+}
+
+/* Write and free a badji file being built. */
+int writeindex(indexer *ix, char *filename)
+{
+    // Check number of blocks
+    int ret = 0;
+    if (ix->nblks > ix->maxblks)
+    {
+        fprintf(stderr, "Too many blocks to handle.\n");
+        ret = 1;
+    }
+    else
+    {
+        // Create badji file
+        FILE *out = fopen(filename, "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "Could not open file.\n");
+            ret = 1;
+        }
+        else
+        {
+            // Write number of blocks, block indices, and first nodes
+            fwrite(&ix->nblks, sizeof(unsigned long long), 1, out);
+            fwrite(ix->indices, sizeof(unsigned long long), ix->nblks, out);
+            writeids(out, ix->firstnodes, ix->nblks, ix->idlen);
+
+            // Write edge counts, byte sizes, and checksums of blocks after a magic number, where older readers stop
+            fwrite(BADJIEXTMAGIC, 1, 8, out);
+            fwrite(ix->edges, sizeof(unsigned long long), ix->nblks, out);
+            fwrite(ix->bytes, sizeof(unsigned long long), ix->nblks, out);
+            fwrite(ix->checksums, sizeof(unsigned long long), ix->nblks, out);
+
+            // Check that every write reached the file
+            int err = ferror(out);
+            if (fclose(out) != 0 || err)
+            {
+                fprintf(stderr, "Could not write badji file.\n");
+                ret = 1;
+            }
+        }
+    }
+
+    // Free block indices, first nodes, and block statistics
+    free(ix->indices);
+    free(ix->firstnodes);
+    free(ix->edges);
+    free(ix->bytes);
+    free(ix->checksums);
+
+    return ret;
+}
+
+/* Get the index just past the end of a block in the graph file. */
+static unsigned long long blockend(graph *g, unsigned long long blockno)
+{
+    return (blockno + 1 < g->nblks) ? g->indices[blockno+1] : g->filelen;
+}
+
+/* Get the first node of a block, or the number of nodes past the last. */
+static unsigned long long blockfirst(graph *g, unsigned long long blockno)
+{
+    return (blockno < g->nblks) ? g->firstnodes[blockno] : g->n;
+}
+
+/* Ask the kernel to start reading a block in the background, so the
+ * thread that claims it finds it in memory. */
+static void prefetchblock(graph *g, unsigned long long blockno)
+{
+    if (blockno >= g->nblks || (g->active != NULL && !g->active[blockno]))
+    {
+        return;
+    }
+    unsigned long long offset = g->indices[blockno];
+    unsigned long long len = blockend(g, blockno) - offset;
+    if (g->map != NULL)
+    {
+        // Align start of range to page
+        unsigned long long pagesize = sysconf(_SC_PAGESIZE);
+        unsigned long long aligned = offset - offset % pagesize;
+        madvise(g->map + aligned, len + (offset - aligned), MADV_WILLNEED);
+    }
+    else if (g->directfd < 0)
+    {
+        posix_fadvise(fileno(g->stream), offset, len, POSIX_FADV_WILLNEED);
+    }
+}
+
+/* Get how many blocks ahead to prefetch, which with affinity is per
+ * thread in its own range, splitting the window of g->prefetch blocks
+ * among threads. Returns 0 if prefetching is off. */
+static unsigned long long prefetchdepth(graph *g)
+{
+    if (g->affinity)
+    {
+        return (g->prefetch + g->nthreads - 1) / g->nthreads;
+    }
+    return g->prefetch;
+}
+
+/* Allocate a block buffer, aligned and backed by huge pages where
+ * available if the graph is read directly. */
+static char *allocblockbuf(graph *g)
+{
+    if (g->align == 0)
+    {
+        return malloc(g->blockbuflen);
+    }
+
+    // Try reserved huge pages, then transparent huge pages
+    char *buf = mmap(NULL, g->blockbuflen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (buf == MAP_FAILED)
+    {
+        buf = mmap(NULL, g->blockbuflen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED)
+        {
+            return NULL;
+        }
+        madvise(buf, g->blockbuflen, MADV_HUGEPAGE);
+    }
+    return buf;
+}
+
+/* Start a pass over the blocks of the graph. */
+int resetblocks(graph *g)
+{
+    // Account for idle time in previous pass
+    accountidle(g);
+
+    // Reset shared block cursor and per-thread cursors
+    g->nextblk = 0;
+    g->inpass = 1;
+    unsigned int i;
+    for (i = 0; i < g->nthreads; i++)
+    {
+        g->cursors[i].next = g->ownblks[i];
+        g->cursors[i].end = g->ownblks[i+1];
+    }
+
+    // Prefetch blocks in the window ahead of the cursor, or the first blocks of each thread
+    unsigned long long depth = prefetchdepth(g);
+    unsigned long long b;
+    for (b = 0; b < depth && !g->affinity; b++)
+    {
+        prefetchblock(g, b);
+    }
+    for (i = 0; i < g->nthreads && g->affinity; i++)
+    {
+        for (b = g->ownblks[i]; b < g->ownblks[i] + depth && b < g->ownblks[i+1]; b++)
+        {
+            prefetchblock(g, b);
+        }
+    }
+
+    // Reset per-thread timers
+    double now = omp_get_wtime();
+    for (i = 0; i < g->nthreads; i++)
+    {
+        g->started[i] = now;
+        g->finished[i] = now;
+        g->passbusy[i] = g->busy[i];
+    }
+
+    // Record counters at start of pass
+    sumcounters(g, &g->passstart);
+    g->passstarted = now;
+    g->lastprogress = now;
+
+    return 0;
+}
+
+/* Claim the next active block of a thread's own range or, once it is done,
+ * of the nearest thread with blocks left, returning the number of blocks
+ * if there are none. Threads with nearby numbers share a socket when
+ * bound with OMP_PROC_BIND=close, so blocks are stolen there first. */
+static unsigned long long claimblock(graph *g, unsigned int threadno)
+{
+    unsigned int k;
+    for (k = 0; k < g->nthreads; k++)
+    {
+        cursor *c = &g->cursors[(threadno + k) % g->nthreads];
+        unsigned long long blockno;
+        do
+        {
+            #pragma omp atomic capture
+            blockno = c->next++;
+        }
+        while (g->active != NULL && blockno < c->end && !g->active[blockno]);
+        if (blockno < c->end)
+        {
+            return blockno;
+        }
+    }
+    return g->nblks;
+}
+
+/* Allocate a vector of len bytes or, if out of core, map it from a
+ * temporary file created in the directory of the file near. The file is
+ * unlinked at once, so it goes away when unmapped, even after a crash.
+ * Returns NULL if the vector could not be allocated. */
+void *allocvector(unsigned long long len, char ooc, char *near)
+{
+    if (!ooc)
+    {
+        return malloc(len);
+    }
+    if (len == 0)
+    {
+        return NULL;
+    }
+
+    // Create temporary file next to near
+    char tmpname[FILENAMELEN + 32];
+    char *slash = strrchr(near, '/');
+    int dirlen = (slash != NULL) ? slash - near + 1 : 0;
+    snprintf(tmpname, sizeof(tmpname), "%.*svector.XXXXXX", dirlen, near);
+    int fd = mkstemp(tmpname);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Could not create temporary file.\n");
+        return NULL;
+    }
+    unlink(tmpname);
+
+    // Reserve space and map file
+    void *v = NULL;
+    if (posix_fallocate(fd, 0, len) == 0)
+    {
+        v = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        if (v == MAP_FAILED)
+        {
+            v = NULL;
+        }
+    }
+    close(fd);
+    if (v == NULL)
+    {
+        fprintf(stderr, "Could not map vector from temporary file.\n");
+    }
+    return v;
+}
+
+/* Free a vector of len bytes allocated by allocvector. */
+void freevector(void *v, unsigned long long len, char ooc)
+{
+    if (v == NULL)
+    {
+        return;
+    }
+    if (!ooc)
+    {
+        free(v);
+    }
+    else
+    {
+        munmap(v, len);
+    }
+}
+
+/* Zero a vector of size bytes per node, with each thread writing the nodes
+ * of the blocks it owns so that, with threads bound to cores, the pages of
+ * the range are first touched on the socket of the thread whose blocks
+ * update them (with --affinity) and the vector is spread across sockets
+ * as the work is. */
+int placevector(graph *g, void *x, unsigned long long size)
+{
+    long long t;
+    #pragma omp parallel for schedule(static, 1)
+    for (t = 0; t < g->nthreads; t++)
+    {
+        unsigned long long first = (t == 0) ? 0 : blockfirst(g, g->ownblks[t]);
+        unsigned long long last = blockfirst(g, g->ownblks[t+1]);
+        memset((char *) x + first * size, 0, (last - first) * size);
+    }
+
+    return 0;
+}
+
+/* Get the next block of the graph, returning 1 if the pass is over. */
+int nextblock(graph *g, unsigned int threadno)
+{
+    // Test for badji file
+    if (!g->badji)
+    {
+        fprintf(stderr, "Graph must have a badji file.\n");
+        return 1;
+    }
+
+    // Account for time spent on previous block
+    double now = omp_get_wtime();
+    g->busy[threadno] += now - g->started[threadno];
+    g->started[threadno] = now;
+
+    // Claim block from own blocks and then other threads' blocks if blocks
+    // have affinity, or else from shared cursor, skipping inactive blocks
+    unsigned long long blockno;
+    if (g->affinity)
+    {
+        blockno = claimblock(g, threadno);
+    }
+    else
+    {
+        do
+        {
+            #pragma omp atomic capture
+            blockno = g->nextblk++;
+        }
+        while (g->active != NULL && blockno < g->nblks && !g->active[blockno]);
+    }
+
+    // Check if pass is over
+    if (blockno >= g->nblks)
+    {
+        g->finished[threadno] = now;
+        return 1;
+    }
+
+    // Prefetch block entering the window ahead of the cursor, or ahead of the thread in its range
+    unsigned long long depth = prefetchdepth(g);
+    if (depth > 0)
+    {
+        prefetchblock(g, blockno + depth);
+    }
+
+    // Report progress if due
+    double lastprogress;
+    #pragma omp atomic read
+    lastprogress = g->lastprogress;
+    if (g->progress > 0.0 && now - lastprogress >= g->progress)
+    {
+        #pragma omp critical(progress)
+        if (now - g->lastprogress >= g->progress)
+        {
+            #pragma omp atomic write
+            g->lastprogress = now;
+            fprintf(stderr, "Progress: pass %llu, block %llu of %llu (%.3f s)\n", g->npasses + 1, blockno + 1, g->nblks, now - g->passstarted);
+        }
+    }
+
+    // Seek to block
+    return seekblock(g, threadno, blockno);
+}
+
+/* Seek to a block of the graph. */
+int seekblock(graph *g, unsigned int threadno, unsigned long long blockno)
+{
+    // Set block number
+    g->currblockno[threadno] = blockno + 1;
+
+    // Set block position
+    if (g->map != NULL)
+    {
+        g->currptr[threadno] = g->map + g->indices[blockno];
+    }
+    else
+    {
+        // Round block out to alignment for direct reads
+        unsigned long long start = g->indices[blockno];
+        unsigned long long end = blockend(g, blockno);
+        int fd = fileno(g->stream);
+        if (g->directfd >= 0)
+        {
+            start -= start % g->align;
+            end = (end + g->align - 1) / g->align * g->align;
+            fd = g->directfd;
+        }
+
+        // Read block into block buffer
+        double readstart = omp_get_wtime();
+        char *buf = g->blockbuf[threadno];
+        unsigned long long offset = start;
+        while (offset < blockend(g, blockno))
+        {
+            ssize_t bytesread = pread(fd, buf, end - offset, offset);
+            if (bytesread <= 0)
+            {
+                fprintf(stderr, "Could not read block %llu.\n", blockno);
+                return 1;
+            }
+            buf += bytesread;
+            offset += bytesread;
+        }
+        g->counts[threadno].io += omp_get_wtime() - readstart;
+        g->currptr[threadno] = g->blockbuf[threadno] + (g->indices[blockno] - start);
+    }
+
+    // Set current node
+    g->currnode[threadno] = g->firstnodes[blockno];
+
+    // Count block
+    g->counts[threadno].blocks++;
+    g->counts[threadno].bytes += blockend(g, blockno) - g->indices[blockno];
+    g->counts[threadno].nodes += ((blockno + 1 < g->nblks) ? g->firstnodes[blockno+1] : g->n) - g->firstnodes[blockno];
+
+    return 0;
+}
+
+/* Verify the byte size and checksum of the block a thread just reached
+ * against its badji file. Blocks pass if the badji file has no checksums. */
+int checkblock(graph *g, unsigned int threadno)
+{
+    if (g->blksums == NULL)
+    {
+        return 0;
+    }
+
+    // Compare byte size of block
+    unsigned long long blockno = g->currblockno[threadno] - 1;
+    unsigned long long len = blockend(g, blockno) - g->indices[blockno];
+    if (len != g->blkbytes[blockno])
+    {
+        fprintf(stderr, "Block %llu has %llu bytes, but badji file says %llu.\n", blockno, len, g->blkbytes[blockno]);
+        return 1;
+    }
+
+    // Compare checksum of block
+    if (checksum(0xcbf29ce484222325ULL, (unsigned char *) g->currptr[threadno], len) != g->blksums[blockno])
+    {
+        fprintf(stderr, "Block %llu does not match its checksum.\n", blockno);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Find the block containing a node, trying a guessed block first. */
+unsigned long long blockof(graph *g, unsigned long long node, unsigned long long guess)
+{
+    // Test guessed block
+    if (guess < g->nblks && g->firstnodes[guess] <= node && (guess + 1 == g->nblks || node < g->firstnodes[guess+1]))
+    {
+        return guess;
+    }
+
+    // Otherwise, search first nodes
+    unsigned long long lo = 0, hi = g->nblks;
+    while (hi - lo > 1)
+    {
+        unsigned long long mid = (lo + hi) / 2;
+        if (g->firstnodes[mid] <= node)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Add the time threads waited for the slowest thread in the last pass to their idle times. */
+static void accountidle(graph *g)
+{
+    if (!g->inpass)
+    {
+        return;
+    }
+
+    // Find time of last thread to finish
+    double last = 0.0;
+    unsigned int i;
+    for (i = 0; i < g->nthreads; i++)
+    {
+        if (g->finished[i] > last)
+        {
+            last = g->finished[i];
+        }
+    }
+
+    // Accumulate idle times
+    for (i = 0; i < g->nthreads; i++)
+    {
+        g->idle[i] += last - g->finished[i];
+    }
+    g->inpass = 0;
+
+    // Grow pass metrics if needed
+    if (g->npasses == g->passcapacity)
+    {
+        g->passcapacity = (g->passcapacity == 0) ? 64 : 2 * g->passcapacity;
+        g->passes = realloc(g->passes, g->passcapacity * sizeof(pass));
+    }
+
+    // Record metrics of pass as the change in counters since it started
+    pass *p = &g->passes[g->npasses++];
+    sumcounters(g, p);
+    p->time = last - g->passstarted;
+    p->io -= g->passstart.io;
+    p->blocks -= g->passstart.blocks;
+    p->bytes -= g->passstart.bytes;
+    p->nodes -= g->passstart.nodes;
+    p->edges -= g->passstart.edges;
+    p->busy = 0.0;
+    p->maxbusy = 0.0;
+    for (i = 0; i < g->nthreads; i++)
+    {
+        double busy = g->busy[i] - g->passbusy[i];
+        p->busy += busy;
+        if (busy > p->maxbusy)
+        {
+            p->maxbusy = busy;
+        }
+    }
+}
+
+/* Sum the counters of the threads. */
+static void sumcounters(graph *g, pass *p)
+{
+    memset(p, 0, sizeof(pass));
+    unsigned int i;
+    for (i = 0; i < g->nthreads; i++)
+    {
+        p->io += g->counts[i].io;
+        p->blocks += g->counts[i].blocks;
+        p->bytes += g->counts[i].bytes;
+        p->nodes += g->counts[i].nodes;
+        p->edges += g->counts[i].edges;
+    }
+}
+
+/* Print the busy and idle times of the threads. */
+int printbalance(graph *g)
+{
+    // Account for idle time in last pass
+    accountidle(g);
+
+    // Print busy and idle times
+    unsigned int i;
+    for (i = 0; i < g->nthreads; i++)
+    {
+        fprintf(stderr, "Thread %u: busy %.3f s, idle %.3f s\n", i, g->busy[i], g->idle[i]);
+    }
+
+    return 0;
+}
+
+/* Print a string as a JSON string. */
+void printstring(FILE *out, char *str)
+{
+    fputc('"', out);
+    for (; *str != '\0'; str++)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            fputc('\\', out);
+        }
+        if ((unsigned char) *str >= 0x20)
+        {
+            fputc(*str, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/* Print metrics of the passes over the graph as one line of JSON. I/O time
+ * counts only explicit block reads, so it is zero for mapped graphs, whose
+ * page faults count as compute time. */
+int printmetrics(graph *g)
+{
+    fprintf(stderr, "{\"tool\": ");
+    printstring(stderr, g->tool);
+    fprintf(stderr, ", \"file\": ");
+    printstring(stderr, g->filename);
+    fprintf(stderr, ", \"threads\": %u, \"nodes\": %llu, \"edges\": %llu, \"time\": %.6f",
+            g->nthreads, g->n, g->m, omp_get_wtime() - g->initialized);
+
+    // Graphs without a badji file are read sequentially
+    if (!g->badji)
+    {
+        fprintf(stderr, ", \"bytes\": %lld}\n", (long long) ftello(g->stream));
+        return 0;
+    }
+
+    // Account for idle time in last pass
+    accountidle(g);
+
+    // Print totals
+    pass total;
+    sumcounters(g, &total);
+    double busy = 0.0;
+    double maxbusy = 0.0;
+    double idle = 0.0;
+    unsigned int i;
+    for (i = 0; i < g->nthreads; i++)
+    {
+        busy += g->busy[i];
+        idle += g->idle[i];
+        if (g->busy[i] > maxbusy)
+        {
+            maxbusy = g->busy[i];
+        }
+    }
+    fprintf(stderr, ", \"blocks\": %llu, \"blocksread\": %llu, \"bytes\": %llu, \"nodesstreamed\": %llu, \"edgesstreamed\": %llu",
+            g->nblks, total.blocks, total.bytes, total.nodes, total.edges);
+    fprintf(stderr, ", \"io\": %.6f, \"compute\": %.6f, \"idle\": %.6f, \"imbalance\": %.3f",
+            total.io, busy - total.io, idle, (busy > 0.0) ? maxbusy * g->nthreads / busy : 1.0);
+
+    // Print passes
+    fprintf(stderr, ", \"passes\": [");
+    unsigned long long k;
+    for (k = 0; k < g->npasses; k++)
+    {
+        pass *p = &g->passes[k];
+        fprintf(stderr, "%s{\"time\": %.6f, \"blocks\": %llu, \"bytes\": %llu, \"nodes\": %llu, \"edges\": %llu, \"io\": %.6f, \"compute\": %.6f, \"imbalance\": %.3f}",
+                (k > 0) ? ", " : "", p->time, p->blocks, p->bytes, p->nodes, p->edges, p->io, p->busy - p->io,
+                (p->busy > 0.0) ? p->maxbusy * g->nthreads / p->busy : 1.0);
+    }
+
+    // Print threads
+    fprintf(stderr, "], \"perthread\": [");
+    for (i = 0; i < g->nthreads; i++)
+    {
+        counters *c = &g->counts[i];
+        fprintf(stderr, "%s{\"busy\": %.6f, \"idle\": %.6f, \"io\": %.6f, \"blocks\": %llu, \"bytes\": %llu, \"edges\": %llu}",
+                (i > 0) ? ", " : "", g->busy[i], g->idle[i], c->io, c->blocks, c->bytes, c->edges);
+    }
+    fprintf(stderr, "]}\n");
+
+    return 0;
+}
+
+/* Grow the adjacency list buffer of a thread to hold len bytes. */
+static void growbuffer(graph *g, unsigned int threadno, unsigned long long len)
+{
+    if (len > g->buflen[threadno])
+    {
+        g->buflen[threadno] = len;
+        free(g->buf[threadno]);
+        g->buf[threadno] = malloc(len);
+    }
+}
+
+/* Get the next node of the block, or NONODE at the end of the block.
+ * Exactly one of the adjacency list pointers of the node is set, according
+ * to the width of node numbers, and at most one of the weight pointers,
+ * according to the type of weights, so kernels can specialize their loops. */
+unsigned long long nextnode(graph *g, node *v, unsigned int threadno)
+{
+    // Test for badji file
+    if (!g->badji)
+    {
+        fprintf(stderr, "Graph must have a badji file.\n");
+        return NONODE;
+    }
+
+    // If there is no next node
+    unsigned long long blockno = g->currblockno[threadno];
+    if ((blockno < g->nblks && g->currnode[threadno] == g->firstnodes[blockno]) || g->currnode[threadno] == g->n)
+    {
+        return NONODE;
+    }
+
+    // Otherwise, get next node
+    void *adj;
+    void *weights = NULL;
+    if (g->compressed)
+    {
+        // Decode gap-encoded adjacency list, whose first neighbor is zigzag-encoded relative to the node
+        unsigned char *p = (unsigned char *) g->currptr[threadno];
+        v->deg = getvarint(&p);
+        growbuffer(g, threadno, v->deg * g->idlen);
+        adj = g->buf[threadno];
+        unsigned long long curr = g->currnode[threadno];
+        unsigned long long j;
+        for (j = 0; j < v->deg; j++)
+        {
+            unsigned long long x = getvarint(&p);
+            curr += (j > 0) ? x : ((x & 1) ? -(x >> 1) - 1 : (x >> 1));
+            setid(adj, j, curr, g->idlen);
+        }
+        g->currptr[threadno] = (char *) p;
+    }
+    else
+    {
+        // Point into mapped graph file or block buffer, with any weights after the adjacency list
+        v->deg = getid(g->currptr[threadno], 0, g->idlen);
+        adj = g->currptr[threadno] + g->idlen;
+        weights = g->currptr[threadno] + (1 + v->deg) * g->idlen;
+        g->currptr[threadno] += (1 + v->deg) * g->idlen + weightbytes(v->deg, g->wlen, g->idlen);
+    }
+    v->adj = g->wide ? NULL : adj;
+    v->adj64 = g->wide ? adj : NULL;
+    v->weights = (g->wlen == sizeof(float)) ? weights : NULL;
+    v->qweights = (g->wlen == sizeof(unsigned short)) ? weights : NULL;
+    g->counts[threadno].edges += v->deg;
     g->currnode[threadno]++;
     return (g->currnode[threadno] - 1);
 }
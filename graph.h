@@ -3,12 +3,57 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define FILENAMELEN 1024
-#define BLOCKLEN    16777216
-#define MAXBLKS     32768
-#define MAXNODES    4294967296
-#define NTHREADS    8
+#define BLOCKLEN    16777216    // default block length in bytes
+#define MAXBLKS     1048576     // default maximum number of blocks
+#define DIRECTALIGN 4096        // default alignment of direct reads in bytes
+#define HUGEPAGELEN 2097152     // length of huge pages for block buffers
+#define MAXNODES    4294967296  // maximum number of nodes with 32-bit node numbers
+#define NONODE      ((unsigned long long) -1)  // returned by nextnode at the end of a block
+#define CHECKPOINTMAGIC "BADJCKPT"
+#define BADJIEXTMAGIC   "BADJIEXT"  // marks per-block edge counts, byte sizes, and checksums in a badji file
+#define INDEXCHUNKLEN   1048576     // length of chunks read by badjindex
+
+/* Counters of a thread, padded to a cache line so threads do not share lines */
+struct counters
+{
+    unsigned long long blocks;              // blocks read
+    unsigned long long bytes;               // bytes of blocks read
+    unsigned long long nodes;               // nodes streamed
+    unsigned long long edges;               // edges streamed
+    double io;                              // time spent reading blocks
+    char pad[24];
+};
+
+/* Metrics of a pass over the graph */
+struct pass
+{
+    double time;                            // time from start of pass to last thread finishing
+    double io;                              // total time threads spent reading blocks
+    double busy;                            // total time threads spent processing blocks
+    double maxbusy;                         // longest time a thread spent processing blocks
+    unsigned long long blocks;              // blocks read
+    unsigned long long bytes;               // bytes of blocks read
+    unsigned long long nodes;               // nodes streamed
+    unsigned long long edges;               // edges streamed
+};
+
+/* Cursor over the blocks a thread owns, padded to a cache line */
+struct cursor
+{
+    unsigned long long next;                // next block to hand out
+    unsigned long long end;                 // end of blocks owned by thread
+    char pad[48];
+};
+
+typedef struct counters counters;
+typedef struct pass pass;
+typedef struct cursor cursor;
 
 /* Graph in BADJ format */
 struct graph
@@ -16,32 +61,195 @@ struct graph
     char filename[FILENAMELEN];             // name of graph file
     FILE *stream;                           // pointer to graph file
     char badji;                             // whether graph has a badji file
+    char compressed;                        // whether graph is in compressed CBADJ format
+    char wide;                              // whether graph has 64-bit node numbers and degrees (BADJ64 or CBADJ64 format)
+    unsigned int idlen;                     // bytes of node numbers and degrees in graph file
+    unsigned int wlen;                      // bytes of edge weights (4 for WBADJ, 2 for QBADJ), or 0 if unweighted
+    char *map;                              // mapped graph file, or NULL if not mapped
+    unsigned long long filelen;             // length of graph file
+
+    unsigned int nthreads;                  // number of threads
+    unsigned long long blocklen;            // block length in bytes for badjindex
+    unsigned long long maxblks;             // maximum number of blocks
+    char usemap;                            // whether to map the graph file
+    unsigned long long align;               // alignment of direct reads in bytes, or 0 for cached reads
+    unsigned int prefetch;                  // number of blocks to prefetch ahead of the cursor
+    char affinity;                          // whether threads take the blocks of their own node ranges before stealing
+    char *tool;                             // name of tool
+    char metrics;                           // whether to print metrics as JSON
+    double progress;                        // seconds between progress reports, or 0 for none
 
     unsigned long long n;                   // number of nodes
     unsigned long long m;                   // number of edges
     unsigned long long nblks;               // number of blocks
     unsigned long long *indices;            // indices of blocks in graph file
-    unsigned int *firstnodes;               // first nodes in blocks
+    unsigned long long maxblocklen;         // length of longest block in bytes
+    unsigned long long *firstnodes;         // first nodes in blocks
+    unsigned long long *blkedges;           // edges in blocks, or NULL if the badji file has none
+    unsigned long long *blkbytes;           // bytes in blocks, or NULL if the badji file has none
+    unsigned long long *blksums;            // checksums of blocks, or NULL if the badji file has none
+
+    char *active;                           // blocks to hand out in a pass, or NULL for all blocks
+    unsigned long long nextblk;             // next block to hand out in the current pass
+    char inpass;                            // whether a pass has started since the last balance report
+    unsigned long long *ownblks;            // first blocks of the node ranges threads own, followed by the number of blocks
+    cursor *cursors;                        // per-thread cursors over owned blocks if blocks have affinity
+
+    int directfd;                           // graph file opened for direct reads, or -1
+    char **blockbuf;                        // block buffers if not mapped
+    unsigned long long blockbuflen;         // length of block buffers
+    unsigned long long *currblockno;        // current block numbers
+    unsigned long long *currnode;           // current nodes
+    char **currptr;                         // current positions in mapped graph file or block buffers
+    char **buf;                             // adjacency list buffers for compressed graphs
+    unsigned long long *buflen;             // adjacency list buffer lengths in bytes
+
+    double *started;                        // times threads started their current blocks
+    double *finished;                       // times threads finished the current pass
+    double *busy;                           // total times threads spent processing blocks
+    double *idle;                           // total times threads waited at the end of passes
 
-    FILE *currblock[NTHREADS];              // current block file pointers
-    unsigned int currblockno[NTHREADS];     // current block numbers
-    unsigned int currnode[NTHREADS];        // current nodes
+    double initialized;                     // time graph was initialized
+    counters *counts;                       // per-thread counters
+    pass *passes;                           // metrics of finished passes
+    unsigned long long npasses;             // number of finished passes
+    unsigned long long passcapacity;        // capacity of pass metrics
+    pass passstart;                         // totals of counters at start of current pass
+    double *passbusy;                       // busy times of threads at start of current pass
+    double passstarted;                     // time current pass started
+    double lastprogress;                    // time of last progress report
 };
 
 /* Node */
 struct node
 {
-    unsigned int deg;       // out-degree
-    unsigned int *adj;      // adjacent nodes
+    unsigned long long deg;                 // out-degree
+    unsigned int *adj;                      // adjacent nodes if node numbers are 32-bit, otherwise NULL (owned by the graph, valid until the next call to nextnode)
+    unsigned long long *adj64;              // adjacent nodes if node numbers are 64-bit, otherwise NULL
+    float *weights;                         // weights of edges if the graph has float weights, otherwise NULL
+    unsigned short *qweights;               // weights of edges if the graph has 16-bit weights, otherwise NULL
+};
+
+/* Incremental builder of a badji file for a BADJ graph being written */
+struct indexer
+{
+    unsigned long long blocklen;            // block length in bytes
+    unsigned long long maxblks;             // maximum number of blocks
+    unsigned int idlen;                     // bytes of node numbers in graph file
+    unsigned long long nblks;               // number of blocks
+    unsigned long long capacity;            // capacity of block indices and first nodes
+    unsigned long long *indices;            // indices of blocks in graph file
+    unsigned long long *firstnodes;         // first nodes in blocks
+    unsigned long long *edges;              // edges in blocks
+    unsigned long long *bytes;              // bytes in blocks
+    unsigned long long *checksums;          // checksums of blocks
+    unsigned long long offset;              // index of next node in graph file
+    unsigned long long node;                // next node
+};
+
+/* Checkpointing of an iterative computation on a graph */
+struct checkpoint
+{
+    char *filename;                         // checkpoint file, or NULL for none
+    char *kind;                             // kind of computation, at most 8 characters
+    unsigned int interval;                  // iterations between checkpoints
+    unsigned int iter;                      // iteration to start from
+    char init;                              // whether the vector already holds the starting values
 };
 
 typedef struct graph graph;
 typedef struct node node;
+typedef struct indexer indexer;
+typedef struct checkpoint checkpoint;
+
+/* Get the node number at an index of an array of 4- or 8-byte node numbers. */
+static inline unsigned long long getid(void *ids, unsigned long long i, unsigned int idlen)
+{
+    return (idlen == 8) ? ((unsigned long long *) ids)[i] : ((unsigned int *) ids)[i];
+}
+
+/* Set the node number at an index of an array of 4- or 8-byte node numbers. */
+static inline void setid(void *ids, unsigned long long i, unsigned long long x, unsigned int idlen)
+{
+    if (idlen == 8)
+    {
+        ((unsigned long long *) ids)[i] = x;
+    }
+    else
+    {
+        ((unsigned int *) ids)[i] = x;
+    }
+}
+
+/* Get an adjacent node of a node with 32- or 64-bit node numbers. */
+static inline unsigned long long neighbor(node *v, unsigned long long j)
+{
+    return (v->adj != NULL) ? v->adj[j] : v->adj64[j];
+}
+
+/* Get the bytes of the weights of an adjacency list of deg edges, padded
+ * to a multiple of the length of node numbers so degrees stay aligned. */
+static inline unsigned long long weightbytes(unsigned long long deg, unsigned int wlen, unsigned int idlen)
+{
+    return (deg * wlen + idlen - 1) / idlen * idlen;
+}
+
+/* Widen a 16-bit weight, which holds the upper half of a float (bfloat16). */
+static inline float unquantize(unsigned short q)
+{
+    unsigned int bits = (unsigned int) q << 16;
+    float w;
+    memcpy(&w, &bits, sizeof(float));
+    return w;
+}
+
+/* Round a float weight to the nearest 16-bit weight, ties to even. */
+static inline unsigned short quantize(float w)
+{
+    unsigned int bits;
+    memcpy(&bits, &w, sizeof(float));
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return bits >> 16;
+}
+
+/* Get the weight of an edge of a node, which is 1 if the graph is unweighted. */
+static inline float weight(node *v, unsigned long long j)
+{
+    if (v->weights != NULL)
+    {
+        return v->weights[j];
+    }
+    return (v->qweights != NULL) ? unquantize(v->qweights[j]) : 1.0;
+}
 
+char *getoption(int *argc, char *argv[], char *name);               // get and remove a command-line option
+int configure(graph *g, int *argc, char *argv[]);                   // configure graph from environment and options
+int iswide(char *filename);                                         // whether a graph file name is of a format with 64-bit node numbers
+unsigned int weightlen(char *filename);                             // bytes of edge weights of the format of a graph file name
+int checkoutput(graph *g, char *filename, char compressed);         // check that an output file name has the extension of the format written
 int initialize(graph *g, char *filename, char badji);               // initialize graph
 int destroy(graph *g);                                              // destroy graph
 int transpose(graph *g, char *filename);                            // transpose graph
+int transposeooc(graph *g, char *filename, unsigned long long memory);  // transpose graph within a memory budget
+int compress(graph *g, char *filename);                             // compress graph into CBADJ format
 int locality(graph *g, unsigned int window, double *locality);      // compute the locality of a graph
-int badjindex(graph *g);                                            // create a badji file for a BADJ graph
+int badjindex(graph *g, char *filename);                            // create a badji file for a BADJ graph in one pass
+unsigned long long *readperm(graph *g, char *filename);              // read a node permutation
+int writecheckpoint(checkpoint *ck, graph *g, unsigned int iter, void *data, unsigned long long size, unsigned long long count);  // write a checkpoint
+int readcheckpoint(checkpoint *ck, graph *g, void *data, unsigned long long size, unsigned long long count);  // resume from a checkpoint
+int initindex(indexer *ix, graph *g);                               // start a badji file for a BADJ graph being written
+int indexnode(indexer *ix, unsigned long long bytes, unsigned long long deg);  // add a node to a badji file being built
+int indexdata(indexer *ix, void *data, unsigned long long len);     // add bytes of the last node to its block checksum
+int writeindex(indexer *ix, char *filename);                        // write and free a badji file being built
+void *allocvector(unsigned long long len, char ooc, char *near);    // allocate a vector, in an unlinked temporary file next to near if out of core
+void freevector(void *v, unsigned long long len, char ooc);         // free a vector allocated by allocvector
+int placevector(graph *g, void *x, unsigned long long size);        // zero a per-node vector with each thread first touching the nodes it owns
+int resetblocks(graph *g);                                          // start a pass over the blocks of the graph
 int nextblock(graph *g, unsigned int threadno);                     // get the next block of the graph
-unsigned int nextnode(graph *g, node *v, unsigned int threadno);    // get the next node of the block
+int seekblock(graph *g, unsigned int threadno, unsigned long long blockno);  // seek to a block of the graph
+int checkblock(graph *g, unsigned int threadno);                    // verify the checksum of the block just reached
+unsigned long long blockof(graph *g, unsigned long long node, unsigned long long guess);  // find the block containing a node
+int printbalance(graph *g);                                         // print the busy and idle times of the threads
+int printmetrics(graph *g);                                         // print metrics of the passes as JSON
+void printstring(FILE *out, char *str);                             // print a string as a JSON string
+unsigned long long nextnode(graph *g, node *v, unsigned int threadno);  // get the next node of the block, or NONODE
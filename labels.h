@@ -0,0 +1,363 @@
+/* Label Propagation and Union-Find over labels of type LABEL, which are
+ * node numbers. components.c includes this file once for graphs with 32-bit
+ * node numbers and once for graphs with 64-bit node numbers, defining LABEL,
+ * the adjacency list ADJ of a node holding them, and NAME to suffix each
+ * function with the width. */
+
+/* Lower a label to val atomically, returning whether it changed. */
+static inline char NAME(atomicmin)(LABEL *label, LABEL val)
+{
+    LABEL old = __atomic_load_n(label, __ATOMIC_RELAXED);
+    while (val < old)
+    {
+        if (__atomic_compare_exchange_n(label, &old, val, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Perform Label Propagation. With frontier set, skip blocks whose
+ * nodes and referenced blocks had no label changes in the last iteration.
+ * Starts from x if ck says it holds the starting labels, and writes
+ * checkpoints if ck names a file. */
+int NAME(propagate)(graph *g, int maxit, char frontier, LABEL *x, checkpoint *ck)
+{
+    // Initialize x to node numbers unless given
+    long long i;
+    if (!ck->init)
+    {
+        #pragma omp parallel for
+        for (i = 0; i < g->n; i++)
+        {
+            x[i] = i;
+        }
+    }
+
+    // Initialize active blocks, changed blocks, and blocks referenced by each block
+    unsigned long long nwords = (g->nblks + 63) / 64;
+    unsigned long long *deps = NULL;
+    char *changed = NULL;
+    if (frontier && g->nblks > 16384)
+    {
+        fprintf(stderr, "Too many blocks for frontier, processing all blocks.\n");
+        frontier = 0;
+    }
+    if (frontier)
+    {
+        deps = calloc(g->nblks * nwords, sizeof(unsigned long long));
+        changed = calloc(g->nblks, sizeof(char));
+        g->active = malloc(g->nblks * sizeof(char));
+        memset(g->active, 1, g->nblks);
+    }
+
+    // For each iteration
+    unsigned long long nactive = g->nblks;
+    unsigned int iter = ck->iter;
+    while (iter < maxit)
+    {
+        // Propagate labels
+        unsigned long long nprops = 0;
+        double start = omp_get_wtime();
+        resetblocks(g);
+        #pragma omp parallel reduction(+:nprops)
+        {
+            unsigned int threadno = omp_get_thread_num();
+
+            // For each block
+            while (!nextblock(g, threadno))
+            {
+                unsigned long long blockno = g->currblockno[threadno] - 1;
+                unsigned long long *blockdeps = frontier ? deps + blockno * nwords : NULL;
+                unsigned long long lastref = blockno;
+                while (1)
+                {
+                    // Get the next node
+                    node v;
+                    unsigned long long i = nextnode(g, &v, threadno);
+                    if (i == NONODE)
+                    {
+                        break;
+                    }
+
+                    // Compute update for neighbors
+                    unsigned long long j;
+                    for (j = 0; j < v.deg; j++)
+                    {
+                        LABEL vadjj = v.ADJ[j];
+                        LABEL xi = __atomic_load_n(&x[i], __ATOMIC_RELAXED);
+                        LABEL xj = __atomic_load_n(&x[vadjj], __ATOMIC_RELAXED);
+
+                        // Record block referenced by edge in first iteration
+                        if (frontier && iter == ck->iter)
+                        {
+                            lastref = blockof(g, vadjj, lastref);
+                            blockdeps[lastref / 64] |= 1ULL << (lastref % 64);
+                        }
+                        
+                        if (xi < xj && NAME(atomicmin)(&x[vadjj], xi))
+                        {
+                            nprops++;
+                            if (frontier)
+                            {
+                                __atomic_store_n(&changed[blockof(g, vadjj, blockno)], 1, __ATOMIC_RELAXED);
+                            }
+                        }
+                        else if (xi > xj && NAME(atomicmin)(&x[i], xj))
+                        {
+                            nprops++;
+                            if (frontier)
+                            {
+                                __atomic_store_n(&changed[blockno], 1, __ATOMIC_RELAXED);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Update number of iterations
+        double elapsed = omp_get_wtime() - start;
+        iter++;
+
+        // Print number of propagations, blocks processed, and time
+        fprintf(stderr, "%d: %llu (%llu blocks, %.3f s)\n", iter, nprops, nactive, elapsed);
+
+        // Activate blocks that changed or reference a block that changed
+        if (frontier)
+        {
+            unsigned long long *changedbits = calloc(nwords, sizeof(unsigned long long));
+            unsigned long long b;
+            for (b = 0; b < g->nblks; b++)
+            {
+                if (changed[b])
+                {
+                    changedbits[b / 64] |= 1ULL << (b % 64);
+                }
+            }
+            nactive = 0;
+            #pragma omp parallel for reduction(+:nactive)
+            for (b = 0; b < g->nblks; b++)
+            {
+                char active = changed[b];
+                unsigned long long w;
+                for (w = 0; w < nwords && !active; w++)
+                {
+                    active = (deps[b * nwords + w] & changedbits[w]) != 0;
+                }
+                g->active[b] = active;
+                nactive += active;
+            }
+            memset(changed, 0, g->nblks);
+            free(changedbits);
+        }
+        
+        // Stop iterating if no propagations
+        if (nprops == 0)
+        {
+            break;
+        }
+
+        // Write checkpoint if due
+        if (ck->filename != NULL && iter % ck->interval == 0)
+        {
+            writecheckpoint(ck, g, iter, x, sizeof(LABEL), g->n);
+        }
+    }
+
+    // Write final checkpoint
+    if (ck->filename != NULL && iter % ck->interval != 0)
+    {
+        writecheckpoint(ck, g, iter, x, sizeof(LABEL), g->n);
+    }
+
+    // Print thread balance
+    printbalance(g);
+
+    // Clean up
+    free(deps);
+    free(changed);
+    free(g->active);
+    g->active = NULL;
+
+    return 0;
+}
+
+/* Find the root of a node in a concurrent union-find forest,
+ * halving the path on the way. */
+static inline LABEL NAME(find)(LABEL *x, LABEL u)
+{
+    while (1)
+    {
+        LABEL p = __atomic_load_n(&x[u], __ATOMIC_RELAXED);
+        if (p == u)
+        {
+            return u;
+        }
+        LABEL gp = __atomic_load_n(&x[p], __ATOMIC_RELAXED);
+        if (p != gp)
+        {
+            __sync_bool_compare_and_swap(&x[u], p, gp);
+        }
+        u = gp;
+    }
+}
+
+/* Join the trees of two nodes in a concurrent union-find forest by
+ * linking the larger root under the smaller, so each root is the
+ * lowest node of its tree. Returns whether the trees were distinct. */
+static inline char NAME(unite)(LABEL *x, LABEL u, LABEL v)
+{
+    while (1)
+    {
+        u = NAME(find)(x, u);
+        v = NAME(find)(x, v);
+        if (u == v)
+        {
+            return 0;
+        }
+        if (u < v)
+        {
+            LABEL tmp = u;
+            u = v;
+            v = tmp;
+        }
+        if (__sync_bool_compare_and_swap(&x[u], u, v))
+        {
+            return 1;
+        }
+    }
+}
+
+/* Perform Union-Find in one pass over the graph, labeling each
+ * node by the lowest node in its component like Label Propagation. */
+int NAME(unionfind)(graph *g, LABEL *x)
+{
+    // Initialize x to node numbers, making each node its own root
+    long long i;
+    #pragma omp parallel for
+    for (i = 0; i < g->n; i++)
+    {
+        x[i] = i;
+    }
+
+    // Unite the endpoints of each edge
+    unsigned long long nunions = 0;
+    double start = omp_get_wtime();
+    resetblocks(g);
+    #pragma omp parallel reduction(+:nunions)
+    {
+        unsigned int threadno = omp_get_thread_num();
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Unite node with neighbors
+                unsigned long long j;
+                for (j = 0; j < v.deg; j++)
+                {
+                    nunions += NAME(unite)(x, i, v.ADJ[j]);
+                }
+            }
+        }
+    }
+
+    // Compress every path to its root
+    #pragma omp parallel for
+    for (i = 0; i < g->n; i++)
+    {
+        x[i] = NAME(find)(x, i);
+    }
+
+    // Print number of components and time
+    double elapsed = omp_get_wtime() - start;
+    fprintf(stderr, "Components: %llu (%.3f s)\n", g->n - nunions, elapsed);
+
+    // Print thread balance
+    printbalance(g);
+
+    return 0;
+}
+
+/* Write labels in original node order, where perm maps original
+ * to new node numbers, relabeling each component by the lowest
+ * original number of its nodes, so labels do not depend on the order. */
+int NAME(output)(char *filename, LABEL *x, unsigned long long n, unsigned long long *perm)
+{
+    // Relabel components into an array in original node order
+    LABEL *labels = x;
+    if (perm != NULL)
+    {
+        LABEL *lowest = malloc(n * sizeof(LABEL));
+        labels = malloc(n * sizeof(LABEL));
+        if (lowest == NULL || labels == NULL)
+        {
+            fprintf(stderr, "Could not allocate labels.\n");
+            free(lowest);
+            free(labels);
+            return 1;
+        }
+
+        // Find the lowest original node of each component, which is
+        // the first one reached in original order
+        unsigned long long i;
+        for (i = 0; i < n; i++)
+        {
+            lowest[i] = n;
+        }
+        for (i = 0; i < n; i++)
+        {
+            LABEL *slot = &lowest[x[perm[i]]];
+            if (*slot == n)
+            {
+                *slot = i;
+            }
+        }
+
+        // Label each node by the lowest original node of its component
+        long long k;
+        #pragma omp parallel for
+        for (k = 0; k < n; k++)
+        {
+            labels[k] = lowest[x[perm[k]]];
+        }
+        free(lowest);
+    }
+
+    // Write labels
+    int ret = 0;
+    FILE *out = fopen(filename, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open output file.\n");
+        ret = 1;
+    }
+    else
+    {
+        char failed = (fwrite(labels, sizeof(LABEL), n, out) != n);
+        failed |= (fclose(out) != 0);
+        if (failed)
+        {
+            fprintf(stderr, "Could not write output file.\n");
+            remove(filename);
+            ret = 1;
+        }
+    }
+    if (labels != x)
+    {
+        free(labels);
+    }
+
+    return ret;
+}
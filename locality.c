@@ -3,15 +3,21 @@
 /* Computes the locality of a BADJ graph. */
 int main(int argc, char *argv[])
 {
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
     // Check arguments
     if (argc < 3)
     {
-        fprintf(stderr, "Usage: ./locality [BADJ file] [window]\n");
+        fprintf(stderr, "Usage: ./locality [options] [BADJ file] [window]\n");
         return 1;
     }
     
     // Initialize graph
-    graph g;
     if (initialize(&g, argv[1], 0))
     {
         return 1;
@@ -1,142 +1,1311 @@
 #define _GNU_SOURCE
 #include <fcntl.h>
+#include <float.h>
 #include <sys/mman.h>
 #include "graph.h"
 
+/* Precision of vectors and of sums over nodes, set with make FPTYPE=...
+ * ACCTYPE=... KAHAN=1. By default, float vectors are summed in double. */
+#ifndef FPTYPE
 #define FPTYPE float
+#endif
+#ifndef ACCTYPE
+#define ACCTYPE double
+#endif
+#ifndef KAHAN
+#define KAHAN 0
+#endif
 
-/* Perform one iteration of PowerIteration. */
-int poweriterate(graph *g, FPTYPE alpha, FPTYPE *x, FPTYPE *y)
+/* Add a value to a sum, carrying the rounding error in a compensation
+ * term if KAHAN is set */
+#if KAHAN
+#define ACCUMULATE(sum, comp, value) kahanadd(&(sum), &(comp), (value))
+#else
+#define ACCUMULATE(sum, comp, value) ((sum) += (value))
+#endif
+
+/* Machine epsilon of vectors. Values summing to 1 cannot settle closer
+ * than about this in residual norm, since rounding moves each value by up
+ * to an ulp, and atomic adds in varying order round differently on each
+ * iteration. */
+#define FPEPSILON ((sizeof(FPTYPE) == sizeof(float)) ? FLT_EPSILON : (sizeof(FPTYPE) == sizeof(double)) ? DBL_EPSILON : LDBL_EPSILON)
+
+#include "spmv.h"
+
+#define PUSH  0
+#define PULL  1
+#define DELTA 2
+#define BLOCKED 3
+
+#define BINWIDTH 262144     // default nodes per destination bin in blocked mode
+
+/* Contribution pushed along an edge, to a node numbered within its bin */
+struct contribution
+{
+    unsigned int dst;                       // destination relative to the first node of its bin
+    FPTYPE val;                             // contribution to the destination
+};
+
+typedef struct contribution contribution;
+
+#define STAGELEN (64 / sizeof(contribution))  // contributions staged per thread and bin, one cache line
+
+/* Destination bins of propagation blocking, holding the contributions
+ * to each range of nodes contiguously */
+struct bins
+{
+    unsigned int shift;                     // log2 of nodes per bin
+    unsigned long long nbins;               // number of bins
+    unsigned long long *start;              // first contributions of bins, followed by the number of contributions
+    unsigned long long *fill;               // next free contributions of bins
+    contribution *contribs;                 // contributions of all bins
+    contribution *stage;                    // per-thread contributions not yet written to their bins
+    unsigned char *staged;                  // per-thread numbers of staged contributions of bins
+    char ooc;                               // whether contributions are in a temporary file
+};
+
+typedef struct bins bins;
+
+/* Add a value to a sum with Neumaier's variant of Kahan summation. */
+static inline void kahanadd(ACCTYPE *sum, ACCTYPE *comp, ACCTYPE value)
+{
+    ACCTYPE t = *sum + value;
+    if (fabs(*sum) >= fabs(value))
+    {
+        *comp += (*sum - t) + value;
+    }
+    else
+    {
+        *comp += (value - t) + *sum;
+    }
+    *sum = t;
+}
+
+/* Over the nodes from lo to hi, add the remainder to y, zero x for
+ * reuse as the next y, and return the residual norm. Cloned for AVX-512
+ * and AVX2, with the clone chosen at run time. */
+__attribute__((target_clones("avx512f", "avx2", "default")))
+static ACCTYPE updaterange(FPTYPE *restrict x, FPTYPE *restrict y, FPTYPE remainder, unsigned long long lo, unsigned long long hi)
+{
+    ACCTYPE norm = 0.0;
+    ACCTYPE comp = 0.0;
+    unsigned long long i;
+#if !KAHAN
+    #pragma omp simd reduction(+:norm)
+#endif
+    for (i = lo; i < hi; i++)
+    {
+        FPTYPE yi = y[i] + remainder;
+        FPTYPE diff = yi - x[i];
+        ACCUMULATE(norm, comp, (diff < 0.0) ? -diff : diff);
+        y[i] = yi;
+        x[i] = 0.0;
+    }
+    return norm + comp;
+}
+
+/* Distribute the weight y lacks among the nodes, given the total weight
+ * pushed into y, and return the residual norm of y against x, in one
+ * parallel pass over contiguous ranges of nodes. x is zeroed. */
+static ACCTYPE update(graph *g, ACCTYPE mass, FPTYPE *x, FPTYPE *y)
+{
+    FPTYPE remainder = (1.0 - mass) / (ACCTYPE) g->n;
+    ACCTYPE norm = 0.0;
+    #pragma omp parallel reduction(+:norm)
+    {
+        unsigned long long threadno = omp_get_thread_num();
+        unsigned long long nthreads = omp_get_num_threads();
+        norm += updaterange(x, y, remainder, g->n * threadno / nthreads, g->n * (threadno + 1) / nthreads);
+    }
+    return norm;
+}
+
+/* Perform one iteration of PowerIteration by pushing updates
+ * along out-edges into y, which starts at 0, and return the
+ * total weight pushed. */
+ACCTYPE poweriterate(graph *g, FPTYPE alpha, FPTYPE *x, FPTYPE *y)
+{
+    ACCTYPE mass = 0.0;
+    resetblocks(g);
+    #pragma omp parallel reduction(+:mass)
+    {
+        unsigned int threadno = omp_get_thread_num();
+        ACCTYPE threadmass = 0.0;
+        ACCTYPE comp = 0.0;
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Compute update for neighbors
+                if (v.deg != 0)
+                {
+                    FPTYPE update = alpha * x[i] / v.deg;
+                    ACCUMULATE(threadmass, comp, alpha * x[i]);
+
+                    // Push along 32-bit or 64-bit node numbers
+                    unsigned long long j;
+                    if (v.adj != NULL)
+                    {
+                        for (j = 0; j < v.deg; j++)
+                        {
+                            unsigned int vadjj = v.adj[j];
+
+                            #pragma omp atomic
+                            y[vadjj] += update;
+                        }
+                    }
+                    else
+                    {
+                        for (j = 0; j < v.deg; j++)
+                        {
+                            unsigned long long vadjj = v.adj64[j];
+
+                            #pragma omp atomic
+                            y[vadjj] += update;
+                        }
+                    }
+                }
+            }
+        }
+        mass += threadmass + comp;
+    }
+
+    return mass;
+}
+
+/* Count the in-edges of each bin of 2^shift nodes in one pass over the
+ * graph and allocate the bins and per-thread staging buffers, with the
+ * bins in a temporary file next to near if out of core. */
+int initbins(graph *g, bins *b, unsigned int shift, char ooc, char *near)
+{
+    b->shift = shift;
+    b->nbins = (g->n + (1ULL << shift) - 1) >> shift;
+    b->start = calloc(b->nbins + 1, sizeof(unsigned long long));
+    b->fill = malloc(b->nbins * sizeof(unsigned long long));
+    b->ooc = ooc;
+
+    // Count in-edges of bins, per thread and then summed
+    resetblocks(g);
+    #pragma omp parallel
+    {
+        unsigned int threadno = omp_get_thread_num();
+        unsigned long long *count = calloc(b->nbins, sizeof(unsigned long long));
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Count the edge into the bin of each out-neighbor
+                unsigned long long j;
+                for (j = 0; j < v.deg; j++)
+                {
+                    count[neighbor(&v, j) >> shift]++;
+                }
+            }
+        }
+
+        // Add counts of thread
+        unsigned long long bin;
+        for (bin = 0; bin < b->nbins; bin++)
+        {
+            if (count[bin] != 0)
+            {
+                #pragma omp atomic
+                b->start[bin+1] += count[bin];
+            }
+        }
+        free(count);
+    }
+
+    // Turn counts into first contributions of bins
+    unsigned long long bin;
+    for (bin = 0; bin < b->nbins; bin++)
+    {
+        b->start[bin+1] += b->start[bin];
+    }
+
+    // Allocate contributions, in a temporary file if out of core
+    b->contribs = allocvector(b->start[b->nbins] * sizeof(contribution), ooc, near);
+    b->stage = aligned_alloc(64, g->nthreads * b->nbins * STAGELEN * sizeof(contribution));
+    b->staged = calloc(g->nthreads * b->nbins, sizeof(unsigned char));
+    if ((b->contribs == NULL && b->start[b->nbins] != 0) || b->stage == NULL || b->staged == NULL)
+    {
+        fprintf(stderr, "Could not allocate bins.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Free bins allocated by initbins. */
+void freebins(bins *b)
+{
+    freevector(b->contribs, b->start[b->nbins] * sizeof(contribution), b->ooc);
+    free(b->start);
+    free(b->fill);
+    free(b->stage);
+    free(b->staged);
+}
+
+/* Write count staged contributions of a thread to the end of a bin,
+ * claiming their slots with one atomic add. */
+static inline void flushbin(bins *b, contribution *stage, unsigned long long bin, unsigned int count)
+{
+    unsigned long long at;
+    #pragma omp atomic capture
+    {
+        at = b->fill[bin];
+        b->fill[bin] += count;
+    }
+    memcpy(&b->contribs[at], stage, count * sizeof(contribution));
+}
+
+/* Stage a contribution to a node in a thread's buffer for its bin,
+ * writing the buffer to the bin when it fills a cache line. */
+static inline void bincontribution(bins *b, contribution *stage, unsigned char *staged, unsigned long long dst, FPTYPE val)
+{
+    unsigned long long bin = dst >> b->shift;
+    contribution *s = &stage[bin * STAGELEN];
+    s[staged[bin]].dst = dst & ((1ULL << b->shift) - 1);
+    s[staged[bin]].val = val;
+    if (++staged[bin] == STAGELEN)
+    {
+        flushbin(b, s, bin, STAGELEN);
+        staged[bin] = 0;
+    }
+}
+
+/* Perform one iteration of PowerIteration with propagation blocking:
+ * binning writes the update of each edge into the bin of its
+ * destination, and accumulation adds each bin into its range of y,
+ * which starts at 0 and stays in cache, without atomics. Returns the
+ * total weight pushed. */
+ACCTYPE blockediterate(graph *g, FPTYPE alpha, bins *b, FPTYPE *x, FPTYPE *y)
+{
+    // Empty bins
+    long long bin;
+    #pragma omp parallel for
+    for (bin = 0; bin < b->nbins; bin++)
+    {
+        b->fill[bin] = b->start[bin];
+    }
+
+    // Bin updates along out-edges
+    ACCTYPE mass = 0.0;
+    resetblocks(g);
+    #pragma omp parallel reduction(+:mass)
+    {
+        unsigned int threadno = omp_get_thread_num();
+        contribution *stage = &b->stage[threadno * b->nbins * STAGELEN];
+        unsigned char *staged = &b->staged[threadno * b->nbins];
+        ACCTYPE threadmass = 0.0;
+        ACCTYPE comp = 0.0;
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Compute update for neighbors
+                if (v.deg != 0)
+                {
+                    FPTYPE update = alpha * x[i] / v.deg;
+                    ACCUMULATE(threadmass, comp, alpha * x[i]);
+
+                    // Bin along 32-bit or 64-bit node numbers
+                    unsigned long long j;
+                    if (v.adj != NULL)
+                    {
+                        for (j = 0; j < v.deg; j++)
+                        {
+                            bincontribution(b, stage, staged, v.adj[j], update);
+                        }
+                    }
+                    else
+                    {
+                        for (j = 0; j < v.deg; j++)
+                        {
+                            bincontribution(b, stage, staged, v.adj64[j], update);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Write remaining staged updates to their bins
+        unsigned long long k;
+        for (k = 0; k < b->nbins; k++)
+        {
+            if (staged[k] != 0)
+            {
+                flushbin(b, &stage[k * STAGELEN], k, staged[k]);
+                staged[k] = 0;
+            }
+        }
+        mass += threadmass + comp;
+    }
+
+    // Accumulate each bin into its range of y
+    #pragma omp parallel for schedule(dynamic)
+    for (bin = 0; bin < b->nbins; bin++)
+    {
+        FPTYPE *ybin = &y[bin << b->shift];
+        unsigned long long p;
+        for (p = b->start[bin]; p < b->start[bin+1]; p++)
+        {
+            ybin[b->contribs[p].dst] += b->contribs[p].val;
+        }
+    }
+
+    return mass;
+}
+
+/* Perform one iteration of PowerIteration by pulling
+ * updates along in-edges of a transposed graph, where
+ * d holds the inverse out-degrees of the original graph,
+ * and return the total weight pulled. */
+ACCTYPE pulliterate(graph *g, FPTYPE alpha, FPTYPE *d, FPTYPE *x, FPTYPE *y)
+{
+    ACCTYPE mass = 0.0;
+    resetblocks(g);
+    #pragma omp parallel reduction(+:mass)
+    {
+        unsigned int threadno = omp_get_thread_num();
+        ACCTYPE threadmass = 0.0;
+        ACCTYPE comp = 0.0;
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Gather updates from in-neighbors, which only
+                // this thread writes into y[i]
+                ACCTYPE sum = 0.0;
+                unsigned long long j;
+                if (v.adj != NULL)
+                {
+                    for (j = 0; j < v.deg; j++)
+                    {
+                        unsigned int vadjj = v.adj[j];
+                        sum += x[vadjj] * d[vadjj];
+                    }
+                }
+                else
+                {
+                    for (j = 0; j < v.deg; j++)
+                    {
+                        unsigned long long vadjj = v.adj64[j];
+                        sum += x[vadjj] * d[vadjj];
+                    }
+                }
+                y[i] = alpha * sum;
+                ACCUMULATE(threadmass, comp, y[i]);
+            }
+        }
+        mass += threadmass + comp;
+    }
+
+    return mass;
+}
+
+/* Perform one iteration of PowerIteration on a weighted graph by pushing
+ * updates along out-edges in proportion to their weights into y, which
+ * starts at 0, where d holds alpha over the weighted out-degrees, and
+ * return the total weight pushed. */
+ACCTYPE weightediterate(graph *g, FPTYPE alpha, FPTYPE *d, FPTYPE *x, FPTYPE *y)
+{
+    // Push updates through the transposed weighted adjacency matrix
+    spmvt(g, d, x, y);
+
+    // Sum the weight of nodes with out-edges of positive weight
+    ACCTYPE mass = 0.0;
+    #pragma omp parallel reduction(+:mass)
+    {
+        ACCTYPE threadmass = 0.0;
+        ACCTYPE comp = 0.0;
+        long long i;
+        #pragma omp for
+        for (i = 0; i < g->n; i++)
+        {
+            if (d[i] != 0.0)
+            {
+                ACCUMULATE(threadmass, comp, alpha * x[i]);
+            }
+        }
+        mass += threadmass + comp;
+    }
+
+    return mass;
+}
+
+/* Compute alpha over the weighted out-degrees of a weighted graph,
+ * leaving nodes without out-edges of positive weight at 0. */
+int weightedoutdegrees(graph *g, FPTYPE alpha, FPTYPE *d)
+{
+    rowsums(g, d);
+    long long i;
+    #pragma omp parallel for
+    for (i = 0; i < g->n; i++)
+    {
+        d[i] = (d[i] > 0.0) ? alpha / d[i] : 0.0;
+    }
+
+    return 0;
+}
+
+/* Compute the inverse out-degrees of the original graph
+ * from a transposed graph. */
+int outdegrees(graph *g, FPTYPE *d)
+{
+    // Count out-degrees
+    unsigned long long *deg = calloc(g->n, sizeof(unsigned long long));
+    if (deg == NULL && g->n != 0)
+    {
+        fprintf(stderr, "Could not allocate out-degrees.\n");
+        return 1;
+    }
+    resetblocks(g);
+    #pragma omp parallel
+    {
+        unsigned int threadno = omp_get_thread_num();
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Count the edge into i from each in-neighbor
+                unsigned long long j;
+                for (j = 0; j < v.deg; j++)
+                {
+                    unsigned long long vadjj = neighbor(&v, j);
+
+                    #pragma omp atomic
+                    deg[vadjj]++;
+                }
+            }
+        }
+    }
+
+    // Invert out-degrees, leaving dangling nodes at 0
+    long long i;
+    #pragma omp parallel for
+    for (i = 0; i < g->n; i++)
+    {
+        d[i] = (deg[i] != 0) ? 1.0 / (FPTYPE) deg[i] : 0.0;
+    }
+    free(deg);
+
+    return 0;
+}
+
+/* Write a vector in original node order, where perm maps
+ * original to new node numbers. */
+int output(char *filename, FPTYPE *x, unsigned long long n, unsigned long long *perm)
+{
+    FILE *out = fopen(filename, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open output file.\n");
+        return 1;
+    }
+    char failed = 0;
+    if (perm == NULL)
+    {
+        failed |= (fwrite(x, sizeof(FPTYPE), n, out) != n);
+    }
+    else
+    {
+        unsigned long long i;
+        for (i = 0; i < n && !failed; i++)
+        {
+            failed |= (fwrite(&x[perm[i]], sizeof(FPTYPE), 1, out) != 1);
+        }
+    }
+    failed |= (fclose(out) != 0);
+    if (failed)
+    {
+        fprintf(stderr, "Could not write output file.\n");
+        remove(filename);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Perform PowerIteration, pushing along weighted edges if the graph is
+ * weighted, where d holds alpha over the weighted out-degrees, pulling
+ * along a transposed graph if d is otherwise not NULL, or pushing through
+ * destination bins if b is not NULL. x and y are
+ * swapped rather than copied, so on return *x points to whichever vector
+ * holds the result. Starts from x if ck says it holds
+ * the starting values, and writes checkpoints if ck names a file. */
+int power(graph *g, FPTYPE alpha, ACCTYPE tol, int maxit, FPTYPE *d, bins *b, FPTYPE **x, FPTYPE **y, checkpoint *ck)
+{
+    // Initialize x to e/n unless given, and y to 0
+    FPTYPE init = 1.0 / (FPTYPE) g->n;
+    long long i;
+    #pragma omp parallel for
+    for (i = 0; i < g->n; i++)
+    {
+        if (!ck->init)
+        {
+            (*x)[i] = init;
+        }
+        (*y)[i] = 0.0;
+    }
+
+    // For each iteration
+    unsigned int iter = ck->iter;
+    while (iter < maxit)
+    {
+        // Perform iteration
+        double start = omp_get_wtime();
+        ACCTYPE mass;
+        if (g->wlen != 0)
+        {
+            mass = weightediterate(g, alpha, d, *x, *y);
+        }
+        else if (d != NULL)
+        {
+            mass = pulliterate(g, alpha, d, *x, *y);
+        }
+        else if (b != NULL)
+        {
+            mass = blockediterate(g, alpha, b, *x, *y);
+        }
+        else
+        {
+            mass = poweriterate(g, alpha, *x, *y);
+        }
+
+        // Distribute remaining weight and compute residual norm
+        ACCTYPE norm = update(g, mass, *x, *y);
+        double elapsed = omp_get_wtime() - start;
+        iter++;
+
+        // Print residual norm and iteration time
+        fprintf(stderr, "%d: %e (%.3f s)\n", iter, (double) norm, elapsed);
+
+        // Swap x and y, leaving the zeroed x as the next y
+        FPTYPE *tmp = *x;
+        *x = *y;
+        *y = tmp;
+
+        // Stop iterating if residual norm is within tolerance
+        if (norm < tol)
+        {
+            break;
+        }
+
+        // Write checkpoint if due
+        if (ck->filename != NULL && iter % ck->interval == 0)
+        {
+            writecheckpoint(ck, g, iter, *x, sizeof(FPTYPE), g->n);
+        }
+    }
+
+    // Write final checkpoint
+    if (ck->filename != NULL && iter % ck->interval != 0)
+    {
+        writecheckpoint(ck, g, iter, *x, sizeof(FPTYPE), g->n);
+    }
+
+    // Print thread balance
+    printbalance(g);
+
+    return 0;
+}
+
+/* Push the residuals of the nodes in active blocks into x and their
+ * updates into acc, returning the number of blocks processed. */
+unsigned long long deltaiterate(graph *g, FPTYPE alpha, FPTYPE *x, FPTYPE *r, FPTYPE *acc)
+{
+    // Initialize acc to 0
+    long long i;
+    #pragma omp parallel for
+    for (i = 0; i < g->n; i++)
+    {
+        acc[i] = 0.0;
+    }
+
+    unsigned long long nblocks = 0;
+    resetblocks(g);
+    #pragma omp parallel reduction(+:nblocks)
+    {
+        unsigned int threadno = omp_get_thread_num();
+
+        // For each active block
+        while (!nextblock(g, threadno))
+        {
+            nblocks++;
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Move residual of node into x
+                FPTYPE res = r[i];
+                x[i] += res;
+                r[i] = 0.0;
+
+                // Compute update for neighbors
+                if (v.deg != 0)
+                {
+                    FPTYPE update = alpha * res / v.deg;
+
+                    // Push along 32-bit or 64-bit node numbers
+                    unsigned long long j;
+                    if (v.adj != NULL)
+                    {
+                        for (j = 0; j < v.deg; j++)
+                        {
+                            unsigned int vadjj = v.adj[j];
+
+                            #pragma omp atomic
+                            acc[vadjj] += update;
+                        }
+                    }
+                    else
+                    {
+                        for (j = 0; j < v.deg; j++)
+                        {
+                            unsigned long long vadjj = v.adj64[j];
+
+                            #pragma omp atomic
+                            acc[vadjj] += update;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return nblocks;
+}
+
+/* Perform incremental PageRank, tracking the residual r = y(x) - x of
+ * PowerIteration and only streaming blocks whose residual norm is above
+ * threshold times the mean block residual norm. */
+int powerdelta(graph *g, FPTYPE alpha, ACCTYPE tol, int maxit, FPTYPE threshold, FPTYPE *x, FPTYPE *y, FPTYPE *r)
+{
+    // Initialize x to e/n and y to 0
+    FPTYPE init = 1.0 / (FPTYPE) g->n;
+    long long i;
+    #pragma omp parallel for
+    for (i = 0; i < g->n; i++)
+    {
+        x[i] = init;
+        y[i] = 0.0;
+    }
+
+    // Compute residual of x with one full iteration
+    double start = omp_get_wtime();
+    FPTYPE remainder = (1.0 - poweriterate(g, alpha, x, y)) / (ACCTYPE) g->n;
+    #pragma omp parallel for
+    for (i = 0; i < g->n; i++)
+    {
+        r[i] = y[i] + remainder - x[i];
+    }
+    double elapsed = omp_get_wtime() - start;
+
+    // Allocate active blocks and block residual norms
+    g->active = malloc(g->nblks * sizeof(char));
+    ACCTYPE *blockres = malloc(g->nblks * sizeof(ACCTYPE));
+    unsigned long long nblocks = g->nblks;
+
+    // For each iteration
+    unsigned int iter = 0;
+    while (1)
+    {
+        // Compute block residual norms
+        ACCTYPE norm = 0.0;
+        long long b;
+        #pragma omp parallel for schedule(dynamic, 64) reduction(+:norm)
+        for (b = 0; b < g->nblks; b++)
+        {
+            unsigned long long last = (b + 1 < g->nblks) ? g->firstnodes[b+1] : g->n;
+            unsigned long long k;
+            blockres[b] = 0.0;
+            for (k = g->firstnodes[b]; k < last; k++)
+            {
+                blockres[b] += fabs(r[k]);
+            }
+            norm += blockres[b];
+        }
+        iter++;
+
+        // Print residual norm, blocks processed, and iteration time
+        fprintf(stderr, "%d: %e (%llu blocks, %.3f s)\n", iter, (double) norm, nblocks, elapsed);
+
+        // Stop iterating if residual norm is within tolerance
+        if (norm < tol || iter >= maxit)
+        {
+            break;
+        }
+
+        // Activate blocks with large residuals, including at least the largest
+        ACCTYPE cutoff = threshold * norm / g->nblks;
+        ACCTYPE maxres = 0.0;
+        for (b = 0; b < g->nblks; b++)
+        {
+            if (blockres[b] > maxres)
+            {
+                maxres = blockres[b];
+            }
+        }
+        if (cutoff > maxres)
+        {
+            cutoff = maxres;
+        }
+        for (b = 0; b < g->nblks; b++)
+        {
+            g->active[b] = (blockres[b] >= cutoff);
+        }
+
+        // Push residuals of active blocks
+        start = omp_get_wtime();
+        nblocks = deltaiterate(g, alpha, x, r, y);
+
+        // Add updates to residuals, shifting them by the weight the
+        // updates take from the remainder distributed among all nodes
+        ACCTYPE total = 0.0;
+        #pragma omp parallel for reduction(+:total)
+        for (i = 0; i < g->n; i++)
+        {
+            total += y[i];
+        }
+        FPTYPE shift = total / (ACCTYPE) g->n;
+        #pragma omp parallel for
+        for (i = 0; i < g->n; i++)
+        {
+            r[i] += y[i] - shift;
+        }
+        elapsed = omp_get_wtime() - start;
+    }
+
+    // Print thread balance
+    printbalance(g);
+
+    // Clean up
+    free(blockres);
+    free(g->active);
+    g->active = NULL;
+
+    return 0;
+}
+
+/* Read seed sets, one per line of node numbers, into seeds, with set c
+ * at seeds[start[c]] to seeds[start[c+1]], mapping original to new node
+ * numbers with perm if it is not NULL. Returns the number of sets, or 0
+ * on error. */
+unsigned int readseeds(char *filename, unsigned long long n, unsigned long long *perm, unsigned long long **seeds, unsigned long long **start)
 {
-    // Initialize y to 0
-    unsigned int i;
-    for (i = 0; i < g->n; i++)
+    FILE *in = fopen(filename, "r");
+    if (in == NULL)
     {
-        y[i] = 0.0;
+        fprintf(stderr, "Could not open seeds file.\n");
+        return 0;
     }
 
-    #pragma omp parallel
+    // For each line
+    unsigned int k = 0;
+    unsigned long long len = 0;
+    unsigned long long cap = 1024, startcap = 64;
+    *seeds = malloc(cap * sizeof(unsigned long long));
+    *start = malloc(startcap * sizeof(unsigned long long));
+    (*start)[0] = 0;
+    char *line = NULL;
+    size_t linecap = 0;
+    char error = 0;
+    while (!error && getline(&line, &linecap, in) != -1)
+    {
+        // Add each node number on the line to the set
+        unsigned long long setlen = len;
+        char *p = line;
+        char *end;
+        unsigned long long v;
+        while ((v = strtoull(p, &end, 10)), end != p)
+        {
+            if (v >= n)
+            {
+                fprintf(stderr, "Seed out of range: %llu\n", v);
+                error = 1;
+                break;
+            }
+            if (len == cap)
+            {
+                cap *= 2;
+                *seeds = realloc(*seeds, cap * sizeof(unsigned long long));
+            }
+            (*seeds)[len++] = (perm != NULL) ? perm[v] : v;
+            p = end;
+        }
+
+        // Skip empty lines
+        if (error || len == setlen)
+        {
+            continue;
+        }
+        if (k + 2 > startcap)
+        {
+            startcap *= 2;
+            *start = realloc(*start, startcap * sizeof(unsigned long long));
+        }
+        (*start)[++k] = len;
+    }
+    if (!error && k == 0)
+    {
+        fprintf(stderr, "Seeds file has no seed sets.\n");
+        error = 1;
+    }
+    free(line);
+    fclose(in);
+
+    // Free seed sets on error
+    if (error)
+    {
+        free(*seeds);
+        free(*start);
+        return 0;
+    }
+    return k;
+}
+
+/* Perform one iteration of PowerIteration on k interleaved vectors,
+ * with x[i*k+c] the value of node i in vector c, applying each edge to
+ * all k vectors while its adjacency list is in cache. Updates are pushed
+ * along out-edges into y, which starts at 0, or pulled along in-edges of
+ * a transposed graph if d is not NULL. The total weight moved into each
+ * vector is returned in mass. */
+int batchiterate(graph *g, unsigned int k, FPTYPE alpha, FPTYPE *d, FPTYPE *x, FPTYPE *y, ACCTYPE *mass)
+{
+    unsigned int c;
+    for (c = 0; c < k; c++)
+    {
+        mass[c] = 0.0;
+    }
+
+    resetblocks(g);
+    #pragma omp parallel reduction(+:mass[:k])
     {
         unsigned int threadno = omp_get_thread_num();
-        while (1)
+        ACCTYPE *sum = malloc(k * sizeof(ACCTYPE));
+
+        // For each block
+        while (!nextblock(g, threadno))
         {
             while (1)
             {
                 // Get the next node
+                unsigned int c;
                 node v;
-                unsigned int i = nextnode(g, &v, threadno);
-                if (i == (unsigned int) -1)
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
                 {
                     break;
                 }
 
-                // Compute update for neighbors
-                if (v.deg != 0)
+                if (d == NULL)
                 {
-                    FPTYPE update = alpha * x[i] / v.deg;
-                        
-                    unsigned int j;                    
+                    // Push updates of all vectors to out-neighbors
+                    if (v.deg == 0)
+                    {
+                        continue;
+                    }
+                    for (c = 0; c < k; c++)
+                    {
+                        sum[c] = alpha * x[i*k+c] / v.deg;
+                        mass[c] += alpha * x[i*k+c];
+                    }
+                    unsigned long long j;
                     for (j = 0; j < v.deg; j++)
                     {
-                        unsigned int vadjj = v.adj[j];
-                        
-                        #pragma omp atomic
-                        y[vadjj] += update;
+                        FPTYPE *yj = y + neighbor(&v, j) * k;
+                        for (c = 0; c < k; c++)
+                        {
+                            #pragma omp atomic
+                            yj[c] += sum[c];
+                        }
+                    }
+                }
+                else
+                {
+                    // Gather updates of all vectors from in-neighbors
+                    for (c = 0; c < k; c++)
+                    {
+                        sum[c] = 0.0;
+                    }
+                    unsigned long long j;
+                    for (j = 0; j < v.deg; j++)
+                    {
+                        unsigned long long vadjj = neighbor(&v, j);
+                        FPTYPE *xj = x + vadjj * k;
+                        for (c = 0; c < k; c++)
+                        {
+                            sum[c] += xj[c] * d[vadjj];
+                        }
+                    }
+                    for (c = 0; c < k; c++)
+                    {
+                        y[i*k+c] = alpha * sum[c];
+                        mass[c] += y[i*k+c];
                     }
                 }
-                free(v.adj);
-            }
-
-            // Get the next block
-            nextblock(g, threadno);
-
-            // Check if iteration is over
-            if (g->currblockno[threadno] <= NTHREADS)
-            {
-                break;
             }
         }
+        free(sum);
     }
 
-    // Distribute remaining weight among the nodes
-    FPTYPE remainder = 1.0;
-    for (i = 0; i < g->n; i++)
-    {
-        remainder -= y[i];
-    }
-    remainder /= (FPTYPE) g->n;
-    for (i = 0; i < g->n; i++)
-    {
-        y[i] += remainder;
-    }
-    
     return 0;
 }
 
-/* Perform PowerIteration. */
-int power(graph *g, FPTYPE alpha, FPTYPE tol, int maxit, FPTYPE *x, FPTYPE *y)
+/* Perform personalized PowerIteration on k interleaved vectors, where
+ * each vector teleports to, and redistributes the weight it lacks
+ * among, the nodes of its seed set, and stop when every vector is within
+ * tolerance. Pulls along a transposed graph if d is not NULL. x and y
+ * are swapped rather than copied. */
+int batchpower(graph *g, unsigned int k, unsigned long long *seeds, unsigned long long *setstart, FPTYPE alpha, ACCTYPE tol, int maxit, FPTYPE *d, FPTYPE **x, FPTYPE **y, checkpoint *ck)
 {
-    // Initialize x to e/n
-    FPTYPE init = 1.0 / (FPTYPE) g->n;
-    unsigned int i;
-    for (i = 0; i < g->n; i++)
+    // Initialize each vector uniform over its seed set unless given, and y to 0
+    long long i;
+    #pragma omp parallel for
+    for (i = 0; i < g->n * k; i++)
     {
-        x[i] = init;
+        if (!ck->init)
+        {
+            (*x)[i] = 0.0;
+        }
+        (*y)[i] = 0.0;
     }
-
-    // Get next blocks
-    for (i = 0; i < NTHREADS; i++)
+    unsigned int c;
+    unsigned long long s;
+    for (c = 0; c < k && !ck->init; c++)
     {
-        nextblock(g, i);
+        for (s = setstart[c]; s < setstart[c+1]; s++)
+        {
+            (*x)[seeds[s] * k + c] += 1.0 / (FPTYPE) (setstart[c+1] - setstart[c]);
+        }
     }
 
     // For each iteration
-    unsigned int iter = 0;
+    ACCTYPE *mass = malloc(k * sizeof(ACCTYPE));
+    ACCTYPE *norms = malloc(k * sizeof(ACCTYPE));
+    unsigned int iter = ck->iter;
     while (iter < maxit)
     {
         // Perform iteration
-        poweriterate(g, alpha, x, y);
-        iter++;
-        
-        // Compute residual norm
-        FPTYPE norm = 0.0;
-        for (i = 0; i < g->n; i++)
+        double start = omp_get_wtime();
+        batchiterate(g, k, alpha, d, *x, *y, mass);
+
+        // Distribute remaining weight of each vector among its seeds
+        for (c = 0; c < k; c++)
         {
-            norm += fabs(x[i] - y[i]);
+            FPTYPE remainder = (1.0 - mass[c]) / (ACCTYPE) (setstart[c+1] - setstart[c]);
+            for (s = setstart[c]; s < setstart[c+1]; s++)
+            {
+                (*y)[seeds[s] * k + c] += remainder;
+            }
+            norms[c] = 0.0;
         }
-        
-        // Print residual norm
-        fprintf(stderr, "%d: %e\n", iter, norm);
-        
-        // Copy y to x
+
+        // Compute residual norms, zeroing x for reuse as the next y
+        FPTYPE *xv = *x;
+        FPTYPE *yv = *y;
+        #pragma omp parallel for reduction(+:norms[:k])
         for (i = 0; i < g->n; i++)
         {
-            x[i] = y[i];
+            unsigned int c;
+            for (c = 0; c < k; c++)
+            {
+                FPTYPE diff = yv[i*k+c] - xv[i*k+c];
+                norms[c] += (diff < 0.0) ? -diff : diff;
+                xv[i*k+c] = 0.0;
+            }
+        }
+        double elapsed = omp_get_wtime() - start;
+        iter++;
+
+        // Print largest residual norm and iteration time
+        ACCTYPE norm = 0.0;
+        for (c = 0; c < k; c++)
+        {
+            if (norms[c] > norm)
+            {
+                norm = norms[c];
+            }
         }
+        fprintf(stderr, "%d: %e (%.3f s)\n", iter, (double) norm, elapsed);
 
-        // Stop iterating if residual norm is within tolerance
+        // Swap x and y
+        FPTYPE *tmp = *x;
+        *x = *y;
+        *y = tmp;
+
+        // Stop iterating if every residual norm is within tolerance
         if (norm < tol)
         {
             break;
         }
+
+        // Write checkpoint if due
+        if (ck->filename != NULL && iter % ck->interval == 0)
+        {
+            writecheckpoint(ck, g, iter, *x, sizeof(FPTYPE), g->n * k);
+        }
+    }
+
+    // Write final checkpoint
+    if (ck->filename != NULL && iter % ck->interval != 0)
+    {
+        writecheckpoint(ck, g, iter, *x, sizeof(FPTYPE), g->n * k);
+    }
+
+    // Print thread balance
+    printbalance(g);
+
+    free(mass);
+    free(norms);
+
+    return 0;
+}
+
+/* Write k interleaved vectors one after another in original node
+ * order, where perm maps original to new node numbers. */
+int batchoutput(char *filename, FPTYPE *x, unsigned long long n, unsigned int k, unsigned long long *perm)
+{
+    FILE *out = fopen(filename, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open output file.\n");
+        return 1;
+    }
+    char failed = 0;
+    unsigned int c;
+    for (c = 0; c < k && !failed; c++)
+    {
+        unsigned long long i;
+        for (i = 0; i < n && !failed; i++)
+        {
+            unsigned long long v = (perm != NULL) ? perm[i] : i;
+            failed |= (fwrite(&x[v*k+c], sizeof(FPTYPE), 1, out) != 1);
+        }
+    }
+    failed |= (fclose(out) != 0);
+    if (failed)
+    {
+        fprintf(stderr, "Could not write output file.\n");
+        remove(filename);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Read k vectors written one after another in original node order by
+ * output or batchoutput into interleaved x, scaling each to sum to 1, to
+ * warm-start PowerIteration. */
+int readvector(char *filename, FPTYPE *x, unsigned long long n, unsigned int k, unsigned long long *perm)
+{
+    FILE *in = fopen(filename, "r");
+    if (in == NULL)
+    {
+        fprintf(stderr, "Could not open initial vector file.\n");
+        return 1;
+    }
+    unsigned int c;
+    for (c = 0; c < k; c++)
+    {
+        // Read vector
+        ACCTYPE sum = 0.0;
+        unsigned long long i;
+        for (i = 0; i < n; i++)
+        {
+            unsigned long long v = (perm != NULL) ? perm[i] : i;
+            if (fread(&x[v*k+c], sizeof(FPTYPE), 1, in) != 1)
+            {
+                fprintf(stderr, "Initial vector file is too short for the graph, which must have the same nodes.\n");
+                fclose(in);
+                return 1;
+            }
+            sum += x[v*k+c];
+        }
+
+        // Scale vector to sum to 1
+        if (sum <= 0.0)
+        {
+            fprintf(stderr, "Initial vector must have a positive sum.\n");
+            fclose(in);
+            return 1;
+        }
+        for (i = 0; i < n; i++)
+        {
+            x[i*k+c] /= sum;
+        }
+    }
+
+    // Test for trailing data, as from a graph with more nodes
+    if (fgetc(in) != EOF)
+    {
+        fprintf(stderr, "Initial vector file is too long for the graph, which must have the same nodes.\n");
+        fclose(in);
+        return 1;
     }
+    fclose(in);
 
     return 0;
 }
 
 /* Computes the PageRank vector of a graph in
- * BADJ format using PowerIteration. */ 
+ * BADJ format using PowerIteration. In pull mode,
+ * the BADJ file holds the transposed graph. */ 
 int main(int argc, char *argv[])
 {
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
+    // Get permutation file of a reordered graph
+    char *permname = getoption(&argc, argv, "perm");
+
+    // Get mode
+    char mode = PUSH;
+    char *value = getoption(&argc, argv, "mode");
+    if (value != NULL && strcmp(value, "pull") == 0)
+    {
+        mode = PULL;
+    }
+    else if (value != NULL && strcmp(value, "delta") == 0)
+    {
+        mode = DELTA;
+    }
+    else if (value != NULL && strcmp(value, "blocked") == 0)
+    {
+        mode = BLOCKED;
+    }
+    else if (value != NULL && strcmp(value, "push") != 0)
+    {
+        fprintf(stderr, "Unknown mode: %s\n", value);
+        return 1;
+    }
+
+    // Get seeds file for personalized PageRank
+    char *seedsname = getoption(&argc, argv, "seeds");
+    if (seedsname != NULL && (mode == DELTA || mode == BLOCKED))
+    {
+        fprintf(stderr, "Seeds are not supported in delta or blocked mode.\n");
+        return 1;
+    }
+
+    // Get checkpoint file, checkpoint interval, whether to resume,
+    // and initial vector file
+    checkpoint ck = {getoption(&argc, argv, "checkpoint"), "pagerank", 10, 0, 0};
+    if ((value = getoption(&argc, argv, "interval")) != NULL)
+    {
+        ck.interval = atoi(value);
+    }
+    char resume = (getoption(&argc, argv, "resume") != NULL);
+    char *initname = getoption(&argc, argv, "init");
+    if (ck.interval < 1)
+    {
+        fprintf(stderr, "Checkpoint interval must be positive.\n");
+        return 1;
+    }
+    if (resume && ck.filename == NULL)
+    {
+        fprintf(stderr, "Resuming requires a checkpoint file.\n");
+        return 1;
+    }
+    if ((ck.filename != NULL || initname != NULL) && mode == DELTA)
+    {
+        fprintf(stderr, "Checkpoints and initial vectors are not supported in delta mode.\n");
+        return 1;
+    }
+
+    // Get block residual threshold in delta mode
+    FPTYPE threshold = 0.5;
+    if ((value = getoption(&argc, argv, "threshold")) != NULL)
+    {
+        threshold = atof(value);
+    }
+
+    // Get nodes per destination bin in blocked mode
+    unsigned long long binwidth = BINWIDTH;
+    if ((value = getoption(&argc, argv, "binwidth")) != NULL)
+    {
+        binwidth = strtoull(value, NULL, 10);
+    }
+    unsigned int shift = 0;
+    while ((1ULL << shift) < binwidth)
+    {
+        shift++;
+    }
+    if (binwidth == 0 || (1ULL << shift) != binwidth || shift > 31)
+    {
+        fprintf(stderr, "Bin width must be a power of 2 of at most 2^31 nodes.\n");
+        return 1;
+    }
+
     // Check arguments
     if (argc < 3)
     {
-        fprintf(stderr, "Usage: ./pagerank [BADJ file] [maxiter] [optional out file]\n");
+        fprintf(stderr, "Usage: ./pagerank [options] [BADJ file] [maxiter] [optional out file]\n");
         return 1;
     }
     
     // Initialize graph
-    graph g;
     if (initialize(&g, argv[1], 1))
     {
         return 1;
@@ -146,76 +1315,165 @@ int main(int argc, char *argv[])
     fprintf(stderr, "Nodes: %llu\n", g.n);
     fprintf(stderr, "Edges: %llu\n\n", g.m);
 
+    // Check mode of weighted graphs
+    if (g.wlen != 0 && (mode != PUSH || seedsname != NULL))
+    {
+        fprintf(stderr, "Weighted graphs are only supported in push mode without seeds.\n");
+        return 1;
+    }
+
+    // Read permutation
+    unsigned long long *perm = NULL;
+    if (permname != NULL && (perm = readperm(&g, permname)) == NULL)
+    {
+        return 1;
+    }
+
+    // Read seed sets
+    unsigned int k = 1;
+    unsigned long long *seeds = NULL;
+    unsigned long long *setstart = NULL;
+    if (seedsname != NULL && (k = readseeds(seedsname, g.n, perm, &seeds, &setstart)) == 0)
+    {
+        return 1;
+    }
+
     // Set PageRank parameters
     FPTYPE alpha = 0.85;
-    FPTYPE tol = 1e-8;
+    ACCTYPE tol = 1e-8;
+    if (tol < 2 * FPEPSILON)
+    {
+        // Stop within what the precision of vectors can resolve
+        tol = 2 * FPEPSILON;
+    }
     int maxit = atoi(argv[2]);
 
     // Determine whether vectors are out of core
     char ooc = 0;
-    if (g.n > 67108864)
+    if (g.n * k > 67108864)
     {
         ooc = 1;
     }
 
-    // Initialize PageRank vectors
-    FILE *xfile, *yfile;
-    FPTYPE *x, *y;
-    if (!ooc)
+    // Initialize PageRank vectors and, in pull mode or for weighted
+    // graphs, inverse out-degrees or, in delta mode, residuals, with
+    // temporary files of out-of-core vectors next to the output
+    char *near = (argc > 3) ? argv[3] : argv[1];
+    FPTYPE *x = allocvector(g.n * k * sizeof(FPTYPE), ooc, near);
+    FPTYPE *y = allocvector(g.n * k * sizeof(FPTYPE), ooc, near);
+    FPTYPE *d = NULL, *r = NULL;
+    char failed = (x == NULL || y == NULL);
+    if (mode == PULL || g.wlen != 0)
     {
-        x = malloc(g.n * sizeof(FPTYPE));
-        y = malloc(g.n * sizeof(FPTYPE));
+        d = allocvector(g.n * sizeof(FPTYPE), ooc, near);
+        failed |= (d == NULL);
     }
-    else
+    else if (mode == DELTA)
+    {
+        r = allocvector(g.n * sizeof(FPTYPE), ooc, near);
+        failed |= (r == NULL);
+    }
+    if (failed)
     {
-        xfile = fopen("xfile.tmp", "w+");
-        yfile = fopen("yfile.tmp", "w+");
-        fallocate(fileno(xfile), 0, 0, g.n * sizeof(FPTYPE));
-        fallocate(fileno(yfile), 0, 0, g.n * sizeof(FPTYPE));
-        x = (FPTYPE *) mmap(NULL, g.n * sizeof(FPTYPE), PROT_READ|PROT_WRITE, MAP_SHARED, fileno(xfile), 0);
-        y = (FPTYPE *) mmap(NULL, g.n * sizeof(FPTYPE), PROT_READ|PROT_WRITE, MAP_SHARED, fileno(yfile), 0);
+        fprintf(stderr, "Could not allocate vectors.\n");
+        freevector(x, g.n * k * sizeof(FPTYPE), ooc);
+        freevector(y, g.n * k * sizeof(FPTYPE), ooc);
+        freevector(d, g.n * sizeof(FPTYPE), ooc);
+        freevector(r, g.n * sizeof(FPTYPE), ooc);
+        return 1;
     }
 
-    // Perform PowerIteration
-    power(&g, alpha, tol, maxit, x, y);
+    // Place vectors across sockets by the node ranges threads own
+    placevector(&g, x, k * sizeof(FPTYPE));
+    placevector(&g, y, k * sizeof(FPTYPE));
+    if (d != NULL)
+    {
+        placevector(&g, d, sizeof(FPTYPE));
+    }
+    if (r != NULL)
+    {
+        placevector(&g, r, sizeof(FPTYPE));
+    }
 
-    // Optionally output x and destroy PageRank vectors
-    if (!ooc)
+    // Resume from checkpoint if there is one, or else warm-start from initial vector
+    if (resume && access(ck.filename, F_OK) == 0)
     {
-        if (argc > 3)
+        if (readcheckpoint(&ck, &g, x, sizeof(FPTYPE), g.n * k))
         {
-            FILE *out = fopen(argv[3], "w");
-            if (out == NULL)
-            {
-                fprintf(stderr, "Could not open output file.\n");
-            }
-            else
-            {
-                fwrite(x, sizeof(FPTYPE), g.n, out);
-                fclose(out);
-            }
+            return 1;
+        }
+        fprintf(stderr, "Resuming from iteration %u\n", ck.iter);
+    }
+    else if (initname != NULL)
+    {
+        if (readvector(initname, x, g.n, k, perm))
+        {
+            return 1;
         }
-        free(x);
-        free(y);
+        ck.init = 1;
+    }
+
+    // Perform PowerIteration
+    if (mode == DELTA)
+    {
+        powerdelta(&g, alpha, tol, maxit, threshold, x, y, r);
     }
     else
     {
-        if (argc > 3)
+        // Compute inverse out-degrees in pull mode or for weighted graphs
+        if (mode == PULL && outdegrees(&g, d))
+        {
+            return 1;
+        }
+        else if (g.wlen != 0)
+        {
+            weightedoutdegrees(&g, alpha, d);
+        }
+        // Count edges into destination bins in blocked mode
+        bins b;
+        if (mode == BLOCKED && initbins(&g, &b, shift, ooc, near))
+        {
+            return 1;
+        }
+        if (seeds != NULL)
+        {
+            batchpower(&g, k, seeds, setstart, alpha, tol, maxit, d, &x, &y, &ck);
+        }
+        else
+        {
+            power(&g, alpha, tol, maxit, d, (mode == BLOCKED) ? &b : NULL, &x, &y, &ck);
+        }
+        if (mode == BLOCKED)
+        {
+            freebins(&b);
+        }
+    }
+
+    // Optionally output x in original node order
+    int ret = 0;
+    if (argc > 3)
+    {
+        if (seeds != NULL)
         {
-            rename("xfile.tmp", argv[3]);
-            fclose(xfile);
+            ret = batchoutput(argv[3], x, g.n, k, perm);
         }
         else
         {
-            fclose(xfile);
-            remove("xfile.tmp");
+            ret = output(argv[3], x, g.n, perm);
         }
-        fclose(yfile);
-        remove("yfile.tmp");
     }
 
-    // Destroy graph
+    // Destroy PageRank vectors
+    freevector(x, g.n * k * sizeof(FPTYPE), ooc);
+    freevector(y, g.n * k * sizeof(FPTYPE), ooc);
+    freevector(d, g.n * sizeof(FPTYPE), ooc);
+    freevector(r, g.n * sizeof(FPTYPE), ooc);
+
+    // Destroy seed sets, permutation, and graph
+    free(seeds);
+    free(setstart);
+    free(perm);
     destroy(&g);
 
-    return 0;
+    return ret;
 }
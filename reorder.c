@@ -0,0 +1,668 @@
+#define _GNU_SOURCE
+#include "graph.h"
+
+#define HUBCAP 64
+#define NOPOS ((unsigned long long) -1)     // position of a node not in the heap
+
+/* Graph in memory with out-edges and in-edges */
+struct csr
+{
+    unsigned long long n;           // number of nodes
+    unsigned int idlen;             // bytes per node number
+    unsigned long long *outstart;   // starts of out-adjacency lists
+    void *outadj;                   // out-adjacency lists
+    unsigned long long *instart;    // starts of in-adjacency lists
+    void *inadj;                    // in-adjacency lists
+};
+
+/* Max-heap of the unplaced nodes of positive score for greedy ordering,
+ * indexed by node so that scores are updated in place */
+struct heap
+{
+    unsigned long long *nodes;      // nodes in heap order
+    unsigned long long *pos;        // positions of nodes in heap, or NOPOS
+    unsigned long long len;         // number of nodes in heap
+    unsigned int *score;            // scores of nodes
+    char *placed;                   // whether nodes are placed
+};
+
+typedef struct csr csr;
+typedef struct heap heap;
+
+/* Load a BADJ graph into memory with out-edges and in-edges, keeping
+ * node numbers as wide as in the graph. */
+int load(graph *g, csr *c)
+{
+    c->n = g->n;
+    c->idlen = g->idlen;
+    c->outstart = malloc((g->n + 1) * sizeof(unsigned long long));
+    c->outadj = malloc(g->m * g->idlen);
+    c->instart = calloc(g->n + 1, sizeof(unsigned long long));
+    c->inadj = malloc(g->m * g->idlen);
+    if (c->outstart == NULL || c->outadj == NULL || c->instart == NULL || c->inadj == NULL)
+    {
+        fprintf(stderr, "Could not allocate graph.\n");
+        return 1;
+    }
+
+    // Read out-adjacency lists and count in-degrees
+    unsigned long long e = 0;
+    unsigned long long i;
+    for (i = 0; i < g->n; i++)
+    {
+        c->outstart[i] = e;
+        unsigned long long degid = 0;
+        if (fread(&degid, g->idlen, 1, g->stream) != 1)
+        {
+            fprintf(stderr, "Graph file is truncated.\n");
+            return 1;
+        }
+        unsigned long long deg = getid(&degid, 0, g->idlen);
+        if (e + deg > g->m)
+        {
+            fprintf(stderr, "Graph has more edges than its header says.\n");
+            return 1;
+        }
+        if (fread((char *) c->outadj + e * g->idlen, g->idlen, deg, g->stream) != deg)
+        {
+            fprintf(stderr, "Graph file is truncated.\n");
+            return 1;
+        }
+        unsigned long long j;
+        for (j = 0; j < deg; j++)
+        {
+            c->instart[getid(c->outadj, e + j, g->idlen) + 1]++;
+        }
+        e += deg;
+    }
+    c->outstart[g->n] = e;
+
+    // Prefix sum in-degrees and fill in-adjacency lists
+    for (i = 0; i < g->n; i++)
+    {
+        c->instart[i+1] += c->instart[i];
+    }
+    unsigned long long *curr = malloc(g->n * sizeof(unsigned long long));
+    if (curr == NULL)
+    {
+        fprintf(stderr, "Could not allocate graph.\n");
+        return 1;
+    }
+    memcpy(curr, c->instart, g->n * sizeof(unsigned long long));
+    for (i = 0; i < g->n; i++)
+    {
+        unsigned long long k;
+        for (k = c->outstart[i]; k < c->outstart[i+1]; k++)
+        {
+            setid(c->inadj, curr[getid(c->outadj, k, g->idlen)]++, i, g->idlen);
+        }
+    }
+    free(curr);
+
+    return 0;
+}
+
+/* Get the total degree of a node. */
+static unsigned long long degree(csr *c, unsigned long long v)
+{
+    return (c->outstart[v+1] - c->outstart[v]) + (c->instart[v+1] - c->instart[v]);
+}
+
+/* Sort nodes by decreasing total degree, for qsort_r. */
+static int comparedegrees(const void *a, const void *b, void *arg)
+{
+    csr *c = arg;
+    unsigned long long u = *(const unsigned long long *) a;
+    unsigned long long v = *(const unsigned long long *) b;
+    unsigned long long du = degree(c, u);
+    unsigned long long dv = degree(c, v);
+    if (du != dv)
+    {
+        return (du < dv) - (du > dv);
+    }
+    return (u > v) - (u < v);
+}
+
+/* Order nodes by decreasing total degree. */
+int degreeorder(csr *c, unsigned long long *order)
+{
+    unsigned long long i;
+    for (i = 0; i < c->n; i++)
+    {
+        order[i] = i;
+    }
+    qsort_r(order, c->n, sizeof(unsigned long long), comparedegrees, c);
+
+    return 0;
+}
+
+/* Order nodes by breadth-first search over edges in both directions,
+ * starting each component from its lowest-numbered node or, for
+ * Cuthill-McKee, from a node of minimum degree and visiting
+ * neighbors in order of increasing degree. */
+int bfsorder(csr *c, unsigned long long *order, char cuthillmckee)
+{
+    char *visited = calloc(c->n, sizeof(char));
+    unsigned long long *starts = malloc(c->n * sizeof(unsigned long long));
+    if (visited == NULL || starts == NULL)
+    {
+        fprintf(stderr, "Could not allocate order.\n");
+        free(visited);
+        free(starts);
+        return 1;
+    }
+    unsigned long long i;
+
+    // Choose order of start nodes
+    for (i = 0; i < c->n; i++)
+    {
+        starts[i] = i;
+    }
+    if (cuthillmckee)
+    {
+        degreeorder(c, starts);
+        for (i = 0; i < c->n / 2; i++)
+        {
+            unsigned long long tmp = starts[i];
+            starts[i] = starts[c->n-1-i];
+            starts[c->n-1-i] = tmp;
+        }
+    }
+
+    // For each component
+    unsigned long long head = 0, tail = 0;
+    for (i = 0; i < c->n; i++)
+    {
+        if (visited[starts[i]])
+        {
+            continue;
+        }
+        visited[starts[i]] = 1;
+        order[tail++] = starts[i];
+
+        // Visit nodes in queue, which is the order itself
+        while (head < tail)
+        {
+            unsigned long long u = order[head++];
+            unsigned long long first = tail;
+            unsigned long long k;
+            for (k = c->outstart[u]; k < c->outstart[u+1]; k++)
+            {
+                unsigned long long w = getid(c->outadj, k, c->idlen);
+                if (!visited[w])
+                {
+                    visited[w] = 1;
+                    order[tail++] = w;
+                }
+            }
+            for (k = c->instart[u]; k < c->instart[u+1]; k++)
+            {
+                unsigned long long w = getid(c->inadj, k, c->idlen);
+                if (!visited[w])
+                {
+                    visited[w] = 1;
+                    order[tail++] = w;
+                }
+            }
+
+            // Sort newly visited neighbors by increasing degree
+            if (cuthillmckee)
+            {
+                qsort_r(order + first, tail - first, sizeof(unsigned long long), comparedegrees, c);
+                unsigned long long l, r;
+                for (l = first, r = tail; l + 1 < r; l++, r--)
+                {
+                    unsigned long long tmp = order[l];
+                    order[l] = order[r-1];
+                    order[r-1] = tmp;
+                }
+            }
+        }
+    }
+
+    // Reverse order for reverse Cuthill-McKee
+    if (cuthillmckee)
+    {
+        for (i = 0; i < c->n / 2; i++)
+        {
+            unsigned long long tmp = order[i];
+            order[i] = order[c->n-1-i];
+            order[c->n-1-i] = tmp;
+        }
+    }
+
+    free(visited);
+    free(starts);
+
+    return 0;
+}
+
+/* Test whether node u ranks above node v, by higher score and then by lower node. */
+static inline int above(heap *h, unsigned long long u, unsigned long long v)
+{
+    return h->score[u] > h->score[v] || (h->score[u] == h->score[v] && u < v);
+}
+
+/* Put a node at a position of the heap. */
+static inline void putnode(heap *h, unsigned long long i, unsigned long long x)
+{
+    h->nodes[i] = x;
+    h->pos[x] = i;
+}
+
+/* Move the node at a position of the heap up past nodes it ranks above. */
+static void siftup(heap *h, unsigned long long i)
+{
+    unsigned long long x = h->nodes[i];
+    while (i > 0)
+    {
+        unsigned long long p = (i - 1) / 2;
+        if (!above(h, x, h->nodes[p]))
+        {
+            break;
+        }
+        putnode(h, i, h->nodes[p]);
+        i = p;
+    }
+    putnode(h, i, x);
+}
+
+/* Move the node at a position of the heap down past nodes that rank above it. */
+static void siftdown(heap *h, unsigned long long i)
+{
+    unsigned long long x = h->nodes[i];
+    while (2 * i + 1 < h->len)
+    {
+        unsigned long long ch = 2 * i + 1;
+        if (ch + 1 < h->len && above(h, h->nodes[ch+1], h->nodes[ch]))
+        {
+            ch++;
+        }
+        if (!above(h, h->nodes[ch], x))
+        {
+            break;
+        }
+        putnode(h, i, h->nodes[ch]);
+        i = ch;
+    }
+    putnode(h, i, x);
+}
+
+/* Remove a node from the heap if it is in it. */
+static void removenode(heap *h, unsigned long long x)
+{
+    unsigned long long i = h->pos[x];
+    if (i == NOPOS)
+    {
+        return;
+    }
+    h->pos[x] = NOPOS;
+    h->len--;
+    if (i < h->len)
+    {
+        unsigned long long last = h->nodes[h->len];
+        putnode(h, i, last);
+        siftup(h, i);
+        siftdown(h, h->pos[last]);
+    }
+}
+
+/* Add delta to the score of an unplaced node, keeping the nodes of
+ * positive score in the heap in order. */
+static void addscore(heap *h, unsigned long long x, int delta)
+{
+    if (h->placed[x])
+    {
+        return;
+    }
+    h->score[x] += delta;
+    if (h->pos[x] == NOPOS)
+    {
+        if (h->score[x] > 0)
+        {
+            putnode(h, h->len++, x);
+            siftup(h, h->len - 1);
+        }
+    }
+    else if (h->score[x] == 0)
+    {
+        removenode(h, x);
+    }
+    else if (delta > 0)
+    {
+        siftup(h, h->pos[x]);
+    }
+    else
+    {
+        siftdown(h, h->pos[x]);
+    }
+}
+
+/* Add delta to the scores of the nodes related to u: its neighbors
+ * in both directions, and its siblings through in-neighbors of
+ * out-degree at most HUBCAP. */
+static void rescore(csr *c, heap *h, unsigned long long u, int delta)
+{
+    unsigned long long k, l;
+
+    // Out-neighbors
+    for (k = c->outstart[u]; k < c->outstart[u+1]; k++)
+    {
+        addscore(h, getid(c->outadj, k, c->idlen), delta);
+    }
+
+    // In-neighbors and siblings
+    for (k = c->instart[u]; k < c->instart[u+1]; k++)
+    {
+        unsigned long long w = getid(c->inadj, k, c->idlen);
+        addscore(h, w, delta);
+        if (c->outstart[w+1] - c->outstart[w] <= HUBCAP)
+        {
+            for (l = c->outstart[w]; l < c->outstart[w+1]; l++)
+            {
+                unsigned long long x = getid(c->outadj, l, c->idlen);
+                if (x != u)
+                {
+                    addscore(h, x, delta);
+                }
+            }
+        }
+    }
+}
+
+/* Order nodes greedily in the style of Gorder, placing next the node
+ * with the most neighbors and siblings among the last window placed.
+ * Scores change in place in a heap indexed by node, so memory stays
+ * at 17 bytes per node however many updates there are. */
+int greedyorder(csr *c, unsigned long long *order, unsigned int window)
+{
+    heap h;
+    h.nodes = malloc(c->n * sizeof(unsigned long long));
+    h.pos = malloc(c->n * sizeof(unsigned long long));
+    h.len = 0;
+    h.score = calloc(c->n, sizeof(unsigned int));
+    h.placed = calloc(c->n, sizeof(char));
+    if (h.nodes == NULL || h.pos == NULL || h.score == NULL || h.placed == NULL)
+    {
+        fprintf(stderr, "Could not allocate order.\n");
+        free(h.nodes);
+        free(h.pos);
+        free(h.score);
+        free(h.placed);
+        return 1;
+    }
+    unsigned long long i;
+    for (i = 0; i < c->n; i++)
+    {
+        h.pos[i] = NOPOS;
+    }
+
+    // Start from the node of highest degree
+    unsigned long long next;
+    unsigned long long seed = 0;
+    for (next = 1; next < c->n; next++)
+    {
+        if (degree(c, next) > degree(c, seed))
+        {
+            seed = next;
+        }
+    }
+
+    // Place nodes
+    unsigned long long scan = 0;
+    for (i = 0; i < c->n; i++)
+    {
+        // Take the best-scoring unplaced node, or else the
+        // lowest-numbered unplaced node
+        if (i == 0)
+        {
+            next = seed;
+        }
+        else if (h.len > 0)
+        {
+            next = h.nodes[0];
+        }
+        else
+        {
+            while (h.placed[scan])
+            {
+                scan++;
+            }
+            next = scan;
+        }
+
+        // Place node and slide window
+        order[i] = next;
+        removenode(&h, next);
+        h.placed[next] = 1;
+        rescore(c, &h, next, 1);
+        if (i >= window)
+        {
+            rescore(c, &h, order[i-window], -1);
+        }
+    }
+
+    free(h.nodes);
+    free(h.pos);
+    free(h.score);
+    free(h.placed);
+
+    return 0;
+}
+
+/* Write a relabeled BADJ graph, its badji file, and the permutation
+ * from original to new node numbers, as wide as node numbers in the graph. */
+int relabel(graph *g, csr *c, unsigned long long *order, char *filename, char *permname)
+{
+    // Invert order into permutation
+    void *perm = malloc(c->n * c->idlen);
+    if (perm == NULL)
+    {
+        fprintf(stderr, "Could not allocate permutation.\n");
+        return 1;
+    }
+    unsigned long long i;
+    for (i = 0; i < c->n; i++)
+    {
+        setid(perm, order[i], i, c->idlen);
+    }
+
+    // Write permutation
+    FILE *out = fopen(permname, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open file.\n");
+        free(perm);
+        return 1;
+    }
+    char failed = (fwrite(perm, c->idlen, c->n, out) != c->n);
+    failed |= (fclose(out) != 0);
+    if (failed)
+    {
+        fprintf(stderr, "Could not write permutation.\n");
+        remove(permname);
+        free(perm);
+        return 1;
+    }
+
+    // Create BADJ file
+    out = fopen(filename, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open file.\n");
+        free(perm);
+        return 1;
+    }
+    failed |= (fwrite(&g->n, sizeof(unsigned long long), 1, out) != 1);
+    failed |= (fwrite(&g->m, sizeof(unsigned long long), 1, out) != 1);
+
+    // Start badji file
+    indexer ix;
+    initindex(&ix, g);
+
+    // For each new node
+    unsigned long long buflen = 1024;
+    void *adj = malloc(buflen * c->idlen);
+    for (i = 0; i < c->n && adj != NULL; i++)
+    {
+        // Relabel adjacency list of original node
+        unsigned long long u = order[i];
+        unsigned long long deg = c->outstart[u+1] - c->outstart[u];
+        if (deg > buflen)
+        {
+            buflen = deg;
+            free(adj);
+            adj = malloc(buflen * c->idlen);
+            if (adj == NULL)
+            {
+                break;
+            }
+        }
+        unsigned long long j;
+        for (j = 0; j < deg; j++)
+        {
+            setid(adj, j, getid(perm, getid(c->outadj, c->outstart[u] + j, c->idlen), c->idlen), c->idlen);
+        }
+
+        // Write degree and adjacent nodes
+        unsigned long long degid = 0;
+        setid(&degid, 0, deg, c->idlen);
+        failed |= (fwrite(&degid, c->idlen, 1, out) != 1);
+        failed |= (fwrite(adj, c->idlen, deg, out) != deg);
+        indexnode(&ix, (1 + deg) * c->idlen, deg);
+        indexdata(&ix, &degid, c->idlen);
+        indexdata(&ix, adj, deg * c->idlen);
+    }
+    failed |= (fclose(out) != 0);
+    char nomem = (adj == NULL);
+    free(adj);
+    free(perm);
+    if (nomem || failed)
+    {
+        if (nomem)
+        {
+            fprintf(stderr, "Could not allocate adjacency list.\n");
+        }
+        else
+        {
+            fprintf(stderr, "Could not write reordered graph.\n");
+        }
+        remove(filename);
+        free(ix.indices);
+        free(ix.firstnodes);
+        free(ix.edges);
+        free(ix.bytes);
+        free(ix.checksums);
+        return 1;
+    }
+
+    // Write badji file
+    char badjiname[FILENAMELEN + 1];
+    strcpy(badjiname, filename);
+    strcat(badjiname, "i");
+    return writeindex(&ix, badjiname);
+}
+
+/* Reorders the nodes of a BADJ graph to improve locality. */
+int main(int argc, char *argv[])
+{
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
+    // Get window for greedy ordering
+    unsigned int window = 5;
+    char *value = getoption(&argc, argv, "window");
+    if (value != NULL)
+    {
+        window = atoi(value);
+    }
+
+    // Check arguments
+    if (argc < 5)
+    {
+        fprintf(stderr, "Usage: ./reorder [options] [BADJ file] [bfs|rcm|degree|gorder] [reordered BADJ file] [permutation file]\n");
+        return 1;
+    }
+    char *method = argv[2];
+    if (strcmp(method, "bfs") != 0 && strcmp(method, "rcm") != 0 && strcmp(method, "degree") != 0 && strcmp(method, "gorder") != 0)
+    {
+        fprintf(stderr, "Unknown ordering: %s\n", method);
+        return 1;
+    }
+
+    // Initialize graph
+    if (initialize(&g, argv[1], 0))
+    {
+        return 1;
+    }
+    if (g.compressed)
+    {
+        fprintf(stderr, "Graph must be in uncompressed BADJ format.\n");
+        return 1;
+    }
+    if (g.wlen != 0)
+    {
+        fprintf(stderr, "Weighted graphs are not supported.\n");
+        return 1;
+    }
+    if (checkoutput(&g, argv[3], 0))
+    {
+        return 1;
+    }
+
+    // Print numbers of nodes and edges
+    fprintf(stderr, "Nodes: %llu\n", g.n);
+    fprintf(stderr, "Edges: %llu\n\n", g.m);
+
+    // Load graph
+    csr c;
+    if (load(&g, &c))
+    {
+        return 1;
+    }
+
+    // Compute order
+    unsigned long long *order = malloc(g.n * sizeof(unsigned long long));
+    if (order == NULL)
+    {
+        fprintf(stderr, "Could not allocate order.\n");
+        return 1;
+    }
+    int ret;
+    if (strcmp(method, "bfs") == 0)
+    {
+        ret = bfsorder(&c, order, 0);
+    }
+    else if (strcmp(method, "rcm") == 0)
+    {
+        ret = bfsorder(&c, order, 1);
+    }
+    else if (strcmp(method, "degree") == 0)
+    {
+        ret = degreeorder(&c, order);
+    }
+    else
+    {
+        ret = greedyorder(&c, order, window);
+    }
+
+    // Write reordered graph and permutation
+    if (!ret)
+    {
+        ret = relabel(&g, &c, order, argv[3], argv[4]);
+    }
+
+    // Clean up
+    free(order);
+    free(c.outstart);
+    free(c.outadj);
+    free(c.instart);
+    free(c.inadj);
+    destroy(&g);
+
+    return ret;
+}
@@ -0,0 +1,138 @@
+/* Sparse matrix-vector products with the weighted adjacency matrix A of a
+ * graph streamed in blocks, where A[i][j] is the weight of the edge from
+ * node i to node j, or 1 if the graph is unweighted. pagerank.c includes
+ * this file after defining the precision FPTYPE of vectors and ACCTYPE of
+ * sums, so its functions are static to the including file. Each product
+ * takes one pass over the graph, with loops specialized for the width of
+ * node numbers and the type of weights, so weighted graphs stream as
+ * unweighted ones do, with a few more bytes per edge. */
+
+/* Add a times the row of A of a node to y with atomic adds. */
+static inline void rowpush(node *v, FPTYPE a, FPTYPE *y)
+{
+    unsigned long long j;
+    if (v->adj != NULL && v->weights != NULL)
+    {
+        for (j = 0; j < v->deg; j++)
+        {
+            #pragma omp atomic
+            y[v->adj[j]] += a * v->weights[j];
+        }
+    }
+    else if (v->adj != NULL && v->qweights != NULL)
+    {
+        for (j = 0; j < v->deg; j++)
+        {
+            #pragma omp atomic
+            y[v->adj[j]] += a * unquantize(v->qweights[j]);
+        }
+    }
+    else if (v->adj != NULL)
+    {
+        for (j = 0; j < v->deg; j++)
+        {
+            #pragma omp atomic
+            y[v->adj[j]] += a;
+        }
+    }
+    else if (v->weights != NULL)
+    {
+        for (j = 0; j < v->deg; j++)
+        {
+            #pragma omp atomic
+            y[v->adj64[j]] += a * v->weights[j];
+        }
+    }
+    else if (v->qweights != NULL)
+    {
+        for (j = 0; j < v->deg; j++)
+        {
+            #pragma omp atomic
+            y[v->adj64[j]] += a * unquantize(v->qweights[j]);
+        }
+    }
+    else
+    {
+        for (j = 0; j < v->deg; j++)
+        {
+            #pragma omp atomic
+            y[v->adj64[j]] += a;
+        }
+    }
+}
+
+/* Compute the row sums of A, the weighted out-degrees, into s. */
+static int rowsums(graph *g, FPTYPE *s)
+{
+    resetblocks(g);
+    #pragma omp parallel
+    {
+        unsigned int threadno = omp_get_thread_num();
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Sum weights of out-edges
+                ACCTYPE sum = v.deg;
+                if (v.weights != NULL || v.qweights != NULL)
+                {
+                    sum = 0.0;
+                    unsigned long long j;
+                    for (j = 0; j < v.deg; j++)
+                    {
+                        sum += weight(&v, j);
+                    }
+                }
+                s[i] = sum;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Add A^T (s .* x) to y, where each node pushes s[i] x[i] along its
+ * out-edges, scaled by their weights, with atomic adds. s may be NULL
+ * to scale by 1. */
+static int spmvt(graph *g, FPTYPE *s, FPTYPE *x, FPTYPE *y)
+{
+    resetblocks(g);
+    #pragma omp parallel
+    {
+        unsigned int threadno = omp_get_thread_num();
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Scatter row of node
+                FPTYPE a = (s != NULL) ? s[i] * x[i] : x[i];
+                if (v.deg != 0 && a != 0.0)
+                {
+                    rowpush(&v, a, y);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,389 @@
+#include "graph.h"
+
+#define NBUCKETS 65     // buckets of histograms: 0, then [2^(k-1), 2^k) for k = 1 to 64
+#define TOPLEN   10     // default number of hubs to report
+
+/* Statistics of the part of a graph streamed by a thread */
+struct profile
+{
+    unsigned long long outhist[NBUCKETS];   // nodes by bucket of out-degree
+    unsigned long long gaphist[NBUCKETS];   // references by bucket of distance from the previous reference in the block
+    unsigned long long edges;               // edges streamed
+    unsigned long long dangling;            // nodes without out-edges
+    unsigned long long selfloops;           // edges from a node to itself
+    unsigned long long duplicates;          // edges repeating an earlier edge of the same node
+    unsigned long long unsorted;            // adjacency lists not in increasing order
+    unsigned long long maxblkedges;         // most edges in a block
+    double minweight;                       // smallest edge weight
+    double maxweight;                       // largest edge weight
+    double sumweight;                       // sum of edge weights
+    unsigned long long *topnodes;           // nodes of largest degree, by decreasing degree
+    unsigned long long *topdegs;            // degrees of nodes of largest degree
+};
+
+typedef struct profile profile;
+
+/* Get the histogram bucket of a value: 0 for 0, or k for [2^(k-1), 2^k). */
+static inline unsigned int bucket(unsigned long long x)
+{
+    return (x == 0) ? 0 : 64 - __builtin_clzll(x);
+}
+
+/* Compare node numbers. */
+static int comparenodes(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *) a;
+    unsigned int y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+/* Compare 64-bit node numbers. */
+static int comparenodes64(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *) a;
+    unsigned long long y = *(const unsigned long long *) b;
+    return (x > y) - (x < y);
+}
+
+/* Start a profile with room for toplen hubs. */
+void initprofile(profile *p, unsigned int toplen)
+{
+    memset(p, 0, sizeof(profile));
+    p->minweight = INFINITY;
+    p->maxweight = -INFINITY;
+    p->topnodes = malloc(toplen * sizeof(unsigned long long));
+    p->topdegs = calloc(toplen, sizeof(unsigned long long));
+}
+
+/* Add a node to the hubs of a profile if its degree is among the
+ * toplen largest, breaking ties by lower node number. */
+void addhub(profile *p, unsigned int toplen, unsigned long long node, unsigned long long deg)
+{
+    // Skip nodes below the last hub
+    if (deg == 0 || deg < p->topdegs[toplen-1]
+     || (deg == p->topdegs[toplen-1] && node > p->topnodes[toplen-1]))
+    {
+        return;
+    }
+
+    // Insert node in order, dropping the last hub
+    unsigned int k = toplen - 1;
+    while (k > 0 && (deg > p->topdegs[k-1] || (deg == p->topdegs[k-1] && node < p->topnodes[k-1])))
+    {
+        p->topnodes[k] = p->topnodes[k-1];
+        p->topdegs[k] = p->topdegs[k-1];
+        k--;
+    }
+    p->topnodes[k] = node;
+    p->topdegs[k] = deg;
+}
+
+/* Add the statistics of a thread's profile to a total profile. */
+void mergeprofile(profile *total, profile *p, unsigned int toplen)
+{
+    unsigned int k;
+    for (k = 0; k < NBUCKETS; k++)
+    {
+        total->outhist[k] += p->outhist[k];
+        total->gaphist[k] += p->gaphist[k];
+    }
+    total->edges += p->edges;
+    total->dangling += p->dangling;
+    total->selfloops += p->selfloops;
+    total->duplicates += p->duplicates;
+    total->unsorted += p->unsorted;
+    total->maxblkedges = (p->maxblkedges > total->maxblkedges) ? p->maxblkedges : total->maxblkedges;
+    total->minweight = (p->minweight < total->minweight) ? p->minweight : total->minweight;
+    total->maxweight = (p->maxweight > total->maxweight) ? p->maxweight : total->maxweight;
+    total->sumweight += p->sumweight;
+    for (k = 0; k < toplen; k++)
+    {
+        addhub(total, toplen, p->topnodes[k], p->topdegs[k]);
+    }
+}
+
+/* Free the hubs of a profile. */
+void freeprofile(profile *p)
+{
+    free(p->topnodes);
+    free(p->topdegs);
+}
+
+/* Profile a graph in one parallel pass over its blocks, counting
+ * in-degrees into indeg, and profile its in-degrees into in in a
+ * parallel pass over the nodes. */
+int profilegraph(graph *g, unsigned int toplen, profile *out, profile *in, unsigned long long *indeg)
+{
+    initprofile(out, toplen);
+    initprofile(in, toplen);
+
+    // Stream graph
+    resetblocks(g);
+    #pragma omp parallel
+    {
+        unsigned int threadno = omp_get_thread_num();
+        profile p;
+        initprofile(&p, toplen);
+        void *sorted = NULL;
+        unsigned long long sortedlen = 0;
+
+        // For each block
+        while (!nextblock(g, threadno))
+        {
+            unsigned long long blkedges = 0;
+            unsigned long long prev = NONODE;
+            while (1)
+            {
+                // Get the next node
+                node v;
+                unsigned long long i = nextnode(g, &v, threadno);
+                if (i == NONODE)
+                {
+                    break;
+                }
+
+                // Count out-degree
+                p.outhist[bucket(v.deg)]++;
+                p.dangling += (v.deg == 0);
+                blkedges += v.deg;
+                addhub(&p, toplen, i, v.deg);
+
+                // For each neighbor
+                char inorder = 1;
+                unsigned long long repeats = 0;
+                unsigned long long j;
+                for (j = 0; j < v.deg; j++)
+                {
+                    unsigned long long vadjj = neighbor(&v, j);
+
+                    // Count in-degree and self-loop
+                    #pragma omp atomic
+                    indeg[vadjj]++;
+                    p.selfloops += (vadjj == i);
+
+                    // Count distance from the previous reference in the block
+                    if (prev != NONODE)
+                    {
+                        p.gaphist[bucket((vadjj > prev) ? vadjj - prev : prev - vadjj)]++;
+                    }
+                    if (j > 0 && vadjj <= prev)
+                    {
+                        repeats += (vadjj == prev);
+                        inorder &= (vadjj == prev);
+                    }
+                    prev = vadjj;
+                }
+
+                // Count duplicates of a sorted adjacency list as repeats,
+                // or else in a sorted copy
+                if (inorder)
+                {
+                    p.duplicates += repeats;
+                }
+                else
+                {
+                    p.unsorted++;
+                    if (v.deg > sortedlen)
+                    {
+                        sortedlen = v.deg;
+                        free(sorted);
+                        sorted = malloc(sortedlen * g->idlen);
+                    }
+                    memcpy(sorted, (v.adj != NULL) ? (void *) v.adj : (void *) v.adj64, v.deg * g->idlen);
+                    qsort(sorted, v.deg, g->idlen, g->wide ? comparenodes64 : comparenodes);
+                    for (j = 1; j < v.deg; j++)
+                    {
+                        p.duplicates += (getid(sorted, j, g->idlen) == getid(sorted, j - 1, g->idlen));
+                    }
+                }
+
+                // Sum weights
+                if (v.weights != NULL || v.qweights != NULL)
+                {
+                    for (j = 0; j < v.deg; j++)
+                    {
+                        double w = weight(&v, j);
+                        p.minweight = (w < p.minweight) ? w : p.minweight;
+                        p.maxweight = (w > p.maxweight) ? w : p.maxweight;
+                        p.sumweight += w;
+                    }
+                }
+            }
+            p.edges += blkedges;
+            p.maxblkedges = (blkedges > p.maxblkedges) ? blkedges : p.maxblkedges;
+        }
+        free(sorted);
+
+        // Add profile of thread
+        #pragma omp critical
+        mergeprofile(out, &p, toplen);
+        freeprofile(&p);
+    }
+
+    // Profile in-degrees, counting nodes without in-edges as dangling
+    #pragma omp parallel
+    {
+        profile p;
+        initprofile(&p, toplen);
+        long long i;
+        #pragma omp for
+        for (i = 0; i < g->n; i++)
+        {
+            p.outhist[bucket(indeg[i])]++;
+            p.dangling += (indeg[i] == 0);
+            addhub(&p, toplen, i, indeg[i]);
+        }
+
+        #pragma omp critical
+        mergeprofile(in, &p, toplen);
+        freeprofile(&p);
+    }
+
+    return 0;
+}
+
+/* Print a histogram of degrees with the largest and mean degree. */
+void printdegrees(char *name, profile *p, unsigned long long n, unsigned long long m, unsigned int toplen)
+{
+    fprintf(stderr, "%s: max %llu, mean %.2f\n", name, p->topdegs[0], (n > 0) ? (double) m / n : 0.0);
+    unsigned int k;
+    for (k = 0; k < NBUCKETS; k++)
+    {
+        if (p->outhist[k] == 0)
+        {
+            continue;
+        }
+        if (k <= 1)
+        {
+            fprintf(stderr, "  %u: %llu\n", k, p->outhist[k]);
+        }
+        else
+        {
+            unsigned long long lo = 1ULL << (k - 1);
+            fprintf(stderr, "  %llu-%llu: %llu\n", lo, lo + (lo - 1), p->outhist[k]);
+        }
+    }
+}
+
+/* Print the hubs of a profile. */
+void printhubs(char *name, profile *p, unsigned int toplen)
+{
+    fprintf(stderr, "%s:", name);
+    unsigned int k;
+    for (k = 0; k < toplen && p->topdegs[k] != 0; k++)
+    {
+        fprintf(stderr, " %llu (%llu)", p->topnodes[k], p->topdegs[k]);
+    }
+    fprintf(stderr, "\n");
+}
+
+/* Prints statistics of a graph in one parallel pass over its blocks. */
+int main(int argc, char *argv[])
+{
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
+    // Get number of hubs to report
+    unsigned int toplen = TOPLEN;
+    char *value = getoption(&argc, argv, "top");
+    if (value != NULL)
+    {
+        toplen = atoi(value);
+    }
+    if (toplen < 1)
+    {
+        fprintf(stderr, "Number of hubs must be positive.\n");
+        return 1;
+    }
+
+    // Check arguments
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: ./stats [options] [BADJ file]\n");
+        return 1;
+    }
+
+    // Initialize graph
+    if (initialize(&g, argv[1], 1))
+    {
+        return 1;
+    }
+
+    // Print numbers of nodes, edges, and blocks
+    fprintf(stderr, "Nodes: %llu\n", g.n);
+    fprintf(stderr, "Edges: %llu\n", g.m);
+    fprintf(stderr, "Blocks: %llu\n\n", g.nblks);
+
+    // Profile graph
+    double start = omp_get_wtime();
+    unsigned long long *indeg = calloc(g.n, sizeof(unsigned long long));
+    if (indeg == NULL)
+    {
+        fprintf(stderr, "Could not allocate in-degrees.\n");
+        return 1;
+    }
+    profile out, in;
+    profilegraph(&g, toplen, &out, &in, indeg);
+    double elapsed = omp_get_wtime() - start;
+
+    // Print counts of special nodes and edges
+    if (out.edges != g.m)
+    {
+        fprintf(stderr, "Edges streamed: %llu, not the %llu in the header\n", out.edges, g.m);
+    }
+    fprintf(stderr, "Most edges in a block: %llu\n", out.maxblkedges);
+    fprintf(stderr, "Dangling nodes: %llu\n", out.dangling);
+    fprintf(stderr, "Nodes without in-edges: %llu\n", in.dangling);
+    fprintf(stderr, "Self-loops: %llu\n", out.selfloops);
+    fprintf(stderr, "Duplicate edges: %llu\n", out.duplicates);
+    fprintf(stderr, "Unsorted adjacency lists: %llu\n", out.unsorted);
+    if (g.wlen != 0 && out.edges != 0)
+    {
+        fprintf(stderr, "Weights: min %e, max %e, mean %e\n", out.minweight, out.maxweight, out.sumweight / out.edges);
+    }
+    fprintf(stderr, "\n");
+
+    // Print degree histograms and hubs
+    printdegrees("Out-degrees", &out, g.n, out.edges, toplen);
+    printdegrees("In-degrees", &in, g.n, out.edges, toplen);
+    fprintf(stderr, "\n");
+    printhubs("Top out-degrees", &out, toplen);
+    printhubs("Top in-degrees", &in, toplen);
+    fprintf(stderr, "\n");
+
+    // Print locality at each power of 2 window, as the share of references
+    // within the window of the previous reference in the same block
+    unsigned long long refs = 0;
+    unsigned int k;
+    for (k = 0; k < NBUCKETS; k++)
+    {
+        refs += out.gaphist[k];
+    }
+    fprintf(stderr, "Locality:\n");
+    unsigned long long local = 0;
+    for (k = 0; k < NBUCKETS && refs > 0; k++)
+    {
+        local += out.gaphist[k];
+        fprintf(stderr, "  window %llu: %e\n", 1ULL << k, (double) local / refs);
+        if (local == refs || (1ULL << k) >= g.n)
+        {
+            break;
+        }
+    }
+    fprintf(stderr, "\n");
+
+    // Print time
+    fprintf(stderr, "Time: %.3f s\n", elapsed);
+
+    // Clean up
+    freeprofile(&out);
+    freeprofile(&in);
+    free(indeg);
+    destroy(&g);
+
+    return 0;
+}
@@ -3,59 +3,89 @@
 /* Streams a BADJ graph. */
 int main(int argc, char *argv[])
 {
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
+    // Get whether to verify blocks against their checksums
+    char verify = (getoption(&argc, argv, "verify") != NULL);
+
     // Check arguments
     if (argc < 2)
     {
-        fprintf(stderr, "Usage: ./stream [BADJ file]\n");
+        fprintf(stderr, "Usage: ./stream [options] [BADJ file]\n");
         return 1;
     }
     
     // Initialize graph
-    graph g;
     if (initialize(&g, argv[1], 1))
     {
         return 1;
     }
 
+    // Check for checksums
+    if (verify && g.blksums == NULL)
+    {
+        fprintf(stderr, "Badji file has no checksums. Run badjindex again to add them.\n");
+        return 1;
+    }
+
     // Print numbers of nodes and edges
     fprintf(stderr, "Nodes: %llu\n", g.n);
     fprintf(stderr, "Edges: %llu\n\n", g.m);
 
-    // Get next blocks
-    unsigned int i;
-    for (i = 0; i < NTHREADS; i++)
-    {
-        nextblock(&g, i);
-    }
-
-    #pragma omp parallel
+    // Stream graph
+    double start = omp_get_wtime();
+    int failed = 0;
+    resetblocks(&g);
+    #pragma omp parallel reduction(|:failed)
     {
         unsigned int threadno = omp_get_thread_num();
-        while (1)
+
+        // For each block
+        while (!nextblock(&g, threadno))
         {
+            // Verify block
+            if (verify && checkblock(&g, threadno))
+            {
+                failed = 1;
+            }
+
             // Get the nodes
             while (1)
             {
                 node v;
-                unsigned int i = nextnode(&g, &v, threadno);
-                if (i == (unsigned int) -1)
+                unsigned long long i = nextnode(&g, &v, threadno);
+                if (i == NONODE)
                 {
                     break;
                 }
-                free(v.adj);
-            }
-
-            // Get the next block
-            nextblock(&g, threadno);
-            if (g.currblockno[threadno] <= NTHREADS)
-            {
-                break;
             }
         }
     }
 
+    // Print time
+    double elapsed = omp_get_wtime() - start;
+    fprintf(stderr, "Time: %.3f s\n", elapsed);
+
+    // Print thread balance
+    printbalance(&g);
+
+    // Print verification result
+    if (verify && failed)
+    {
+        fprintf(stderr, "Verification failed.\n");
+    }
+    else if (verify)
+    {
+        fprintf(stderr, "Verified %llu blocks.\n", g.nblks);
+    }
+
     // Destroy graph
     destroy(&g);
 
-    return 0;
+    return failed;
 }
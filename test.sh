@@ -0,0 +1,38 @@
+#!/bin/sh
+# Checks that pagerank converges within its default tolerance before
+# maxiter, alone and for batched seed sets, in push and pull mode, on the
+# sample graph. Prints one line per run and fails if any run does not.
+set -e
+
+MAXIT=${MAXIT:-300}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# Index the sample graph and its transpose in small blocks
+cp data/wb-cs.stanford.badj "$DIR/g.badj"
+./badjindex --blocklen=4096 "$DIR/g.badj" 2>/dev/null
+./transpose "$DIR/g.badj" "$DIR/gt.badj" 2>/dev/null
+printf '0\n5 17\n100 200 300\n9913\n' > "$DIR/seeds.txt"
+
+# Run pagerank and check that its last iteration comes before maxiter
+FAILED=0
+check() {
+    NAME=$1
+    shift
+    ITERS=$(./pagerank "$@" $MAXIT 2>&1 >/dev/null | awk '/^[0-9]+: .* s\)$/ { n = $1 + 0 } END { print n + 0 }')
+    if [ "$ITERS" -gt 0 ] && [ "$ITERS" -lt "$MAXIT" ]; then
+        echo "ok: $NAME converged in $ITERS iterations"
+    else
+        echo "FAIL: $NAME did not converge within $MAXIT iterations"
+        FAILED=1
+    fi
+}
+
+check "push" "$DIR/g.badj"
+check "push with 2 threads" --threads=2 --affinity "$DIR/g.badj"
+check "pull" --mode=pull "$DIR/gt.badj"
+check "batched push" --seeds="$DIR/seeds.txt" "$DIR/g.badj"
+check "batched push with 2 threads" --threads=2 --seeds="$DIR/seeds.txt" "$DIR/g.badj"
+check "batched pull" --mode=pull --seeds="$DIR/seeds.txt" "$DIR/gt.badj"
+
+exit $FAILED
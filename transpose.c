@@ -3,16 +3,25 @@
 /* Transposes a BADJ graph. */
 int main(int argc, char *argv[])
 {
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
+    // Get memory budget in megabytes for out-of-core transpose
+    char *memory = getoption(&argc, argv, "memory");
+
     // Check arguments
     if (argc < 3)
     {
-        fprintf(stderr, "Usage: ./transpose [BADJ file] [transposed BADJ file]\n");
+        fprintf(stderr, "Usage: ./transpose [options] [BADJ file] [transposed BADJ file]\n");
         return 1;
     }
     
     // Initialize graph
-    graph g;
-    if (initialize(&g, argv[1], 0))
+    if (initialize(&g, argv[1], memory == NULL))
     {
         return 1;
     }
@@ -22,7 +31,19 @@ int main(int argc, char *argv[])
     fprintf(stderr, "Edges: %llu\n\n", g.m);
 
     // Transpose graph
-    transpose(&g, argv[2]);
+    if (memory == NULL)
+    {
+        if (transpose(&g, argv[2]))
+        {
+            destroy(&g);
+            return 1;
+        }
+    }
+    else if (transposeooc(&g, argv[2], strtoull(memory, NULL, 10) << 20))
+    {
+        destroy(&g);
+        return 1;
+    }
 
     // Destroy graph
     destroy(&g);
@@ -0,0 +1,216 @@
+#include "graph.h"
+
+/* Advance a splitmix64 random number generator. */
+static unsigned long long nextrandom(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Write a BADJ graph read sequentially as a weighted graph, with the
+ * weights of its edges in edge order read from weights, drawn uniformly
+ * from (0, 1] if random is set, or 1 otherwise, along with its badji file. */
+int addweights(graph *g, FILE *weights, char random, unsigned long long seed, char *filename)
+{
+    // Create weighted graph file
+    unsigned int wlen = weightlen(filename);
+    FILE *out = fopen(filename, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open file.\n");
+        return 1;
+    }
+
+    // Write numbers of nodes and edges
+    char failed = 0;
+    failed |= (fwrite(&g->n, sizeof(unsigned long long), 1, out) != 1);
+    failed |= (fwrite(&g->m, sizeof(unsigned long long), 1, out) != 1);
+
+    // For each node
+    indexer ix;
+    initindex(&ix, g);
+    unsigned long long capacity = 0;
+    void *adj = NULL;
+    float *w = NULL;
+    unsigned long long state = seed;
+    unsigned long long i;
+    int ret = 0;
+    for (i = 0; i < g->n && !ret && !failed; i++)
+    {
+        // Read degree and adjacency list
+        unsigned long long degid = 0;
+        if (fread(&degid, g->idlen, 1, g->stream) != 1)
+        {
+            fprintf(stderr, "Graph file is truncated.\n");
+            ret = 1;
+            break;
+        }
+        unsigned long long deg = getid(&degid, 0, g->idlen);
+        unsigned long long wbytes = weightbytes(deg, wlen, g->idlen);
+        if (deg > capacity)
+        {
+            capacity = deg;
+            free(adj);
+            free(w);
+            adj = malloc(deg * g->idlen);
+            w = malloc(deg * sizeof(float) + sizeof(unsigned long long));
+            if (adj == NULL || w == NULL)
+            {
+                fprintf(stderr, "Could not allocate adjacency list.\n");
+                ret = 1;
+                break;
+            }
+        }
+        if (fread(adj, g->idlen, deg, g->stream) != deg)
+        {
+            fprintf(stderr, "Graph file is truncated.\n");
+            ret = 1;
+            break;
+        }
+
+        // Read or draw weights
+        unsigned long long j;
+        if (weights != NULL)
+        {
+            if (fread(w, sizeof(float), deg, weights) != deg)
+            {
+                fprintf(stderr, "Weights file is truncated.\n");
+                ret = 1;
+                break;
+            }
+        }
+        else
+        {
+            for (j = 0; j < deg; j++)
+            {
+                w[j] = random ? 1.0 - (nextrandom(&state) >> 40) * (1.0 / 16777216.0) : 1.0;
+            }
+        }
+
+        // Quantize weights in place to 16 bits, and zero padding
+        if (wlen == sizeof(unsigned short))
+        {
+            for (j = 0; j < deg; j++)
+            {
+                ((unsigned short *) w)[j] = quantize(w[j]);
+            }
+        }
+        memset((char *) w + deg * wlen, 0, wbytes - deg * wlen);
+
+        // Write and index node
+        failed |= (fwrite(&degid, g->idlen, 1, out) != 1);
+        failed |= (fwrite(adj, g->idlen, deg, out) != deg);
+        failed |= (fwrite(w, 1, wbytes, out) != wbytes);
+        indexnode(&ix, (1 + deg) * g->idlen + wbytes, deg);
+        indexdata(&ix, &degid, g->idlen);
+        indexdata(&ix, adj, deg * g->idlen);
+        indexdata(&ix, w, wbytes);
+    }
+    failed |= (fclose(out) != 0);
+    free(adj);
+    free(w);
+    if (failed && !ret)
+    {
+        fprintf(stderr, "Could not write weighted graph.\n");
+        ret = 1;
+    }
+
+    // Write badji file, or remove partial graph
+    if (ret)
+    {
+        remove(filename);
+        free(ix.indices);
+        free(ix.firstnodes);
+        free(ix.edges);
+        free(ix.bytes);
+        free(ix.checksums);
+        return 1;
+    }
+    char badjiname[FILENAMELEN + 2];
+    strcpy(badjiname, filename);
+    strcat(badjiname, "i");
+    return writeindex(&ix, badjiname);
+}
+
+/* Adds edge weights to a BADJ graph, writing a WBADJ or QBADJ graph. */
+int main(int argc, char *argv[])
+{
+    // Configure graph
+    graph g;
+    if (configure(&g, &argc, argv))
+    {
+        return 1;
+    }
+
+    // Get seed of random weights
+    unsigned long long seed = 1;
+    char *value = getoption(&argc, argv, "seed");
+    if (value != NULL)
+    {
+        seed = strtoull(value, NULL, 10);
+    }
+
+    // Check arguments
+    if (argc < 4)
+    {
+        fprintf(stderr, "Usage: ./weight [options] [BADJ file] [uniform|random|weights file] [WBADJ or QBADJ file]\n");
+        return 1;
+    }
+    if (strlen(argv[3]) > FILENAMELEN)
+    {
+        fprintf(stderr, "Max file name length exceeded.\n");
+        return 1;
+    }
+
+    // Initialize graph
+    if (initialize(&g, argv[1], 0))
+    {
+        return 1;
+    }
+    if (g.compressed || g.wlen != 0)
+    {
+        fprintf(stderr, "Graph must be in unweighted, uncompressed BADJ format.\n");
+        return 1;
+    }
+    if (weightlen(argv[3]) == 0 || iswide(argv[3]) != g.wide)
+    {
+        fprintf(stderr, "Output file must have a weighted extension (.wbadj or .qbadj), with 64 appended exactly when the graph has it.\n");
+        return 1;
+    }
+
+    // Print numbers of nodes and edges
+    fprintf(stderr, "Nodes: %llu\n", g.n);
+    fprintf(stderr, "Edges: %llu\n\n", g.m);
+
+    // Open weights file unless weights are uniform or random
+    FILE *weights = NULL;
+    char random = (strcmp(argv[2], "random") == 0);
+    if (strcmp(argv[2], "uniform") != 0 && !random)
+    {
+        weights = fopen(argv[2], "r");
+        if (weights == NULL)
+        {
+            fprintf(stderr, "Could not open weights file.\n");
+            return 1;
+        }
+    }
+
+    // Write weighted graph
+    double start = omp_get_wtime();
+    int ret = addweights(&g, weights, random, seed, argv[3]);
+    if (!ret)
+    {
+        fprintf(stderr, "Time: %.3f s\n", omp_get_wtime() - start);
+    }
+
+    // Clean up
+    if (weights != NULL)
+    {
+        fclose(weights);
+    }
+    destroy(&g);
+
+    return ret;
+}